@@ -0,0 +1,80 @@
+#pragma once
+#include <Arduino.h>  // for micros(), Print, String
+#include <stdint.h>   // for uint32_t and others
+
+// the phases of setup(), in the order they finish
+enum BootPhase_e : uint8_t {
+    BOOT_SETTINGS,     // LittleFS mounted and the settings loaded
+    BOOT_DISPLAY,      // the NeoPixels are ready
+    BOOT_FIRST_FRAME,  // the RTC is read and the clock face shown
+    BOOT_WIFI,         // FoxieWiFi and its web server
+    BOOT_UPDATE,       // WebUpdate
+    BOOT_MENUS,        // NTP, the config menu and the scheduler's tasks
+    TOTAL_BOOT_PHASES,
+};
+
+/**
+ * When each phase of setup() finished, in microseconds since the ESP came
+ * out of reset. The SDK and the core run before setup() does, which shows
+ * up as the time before Start().
+ *
+ * Everything that isn't needed to show the time goes after
+ * BOOT_FIRST_FRAME, so that's the number to keep down.
+ * */
+class BootTimeline {
+  private:
+    inline static uint32_t m_startUs{0};
+    inline static uint32_t m_phaseUs[TOTAL_BOOT_PHASES];
+
+  public:
+    // first thing in setup()
+    static void Start() { m_startUs = micros(); }
+
+    static void Mark(const BootPhase_e phase) { m_phaseUs[phase] = micros(); }
+
+    // 0 until the phase is done
+    static uint32_t GetMs(const BootPhase_e phase) {
+        return m_phaseUs[phase] / 1000;
+    }
+
+    // e.g. "65/412MS", to the first frame and to the end of setup()
+    static String GetSummary() {
+        return String(GetMs(BOOT_FIRST_FRAME)) + F("/") +
+               String(GetMs((BootPhase_e)(TOTAL_BOOT_PHASES - 1))) + F("MS");
+    }
+
+    // one line per phase, with when it finished and how long it took
+    static void PrintReport(Print& out) {
+        out.println(F("BOOT SETUP AT ") + String(m_startUs) + F("US"));
+        uint32_t previousUs = m_startUs;
+        for (size_t i = 0; i < TOTAL_BOOT_PHASES; ++i) {
+            const uint32_t us = m_phaseUs[i];
+            out.println(String(GetName((BootPhase_e)i)) + F(" AT ") +
+                        String(us) + F("US TOOK ") +
+                        String(us ? us - previousUs : 0) + F("US"));
+            if (us) {
+                previousUs = us;
+            }
+        }
+    }
+
+    static const char* GetName(const BootPhase_e phase) {
+        switch (phase) {
+            case BOOT_SETTINGS:
+                return "SETTINGS";
+            case BOOT_DISPLAY:
+                return "DISPLAY";
+            case BOOT_FIRST_FRAME:
+                return "FRAME";
+            case BOOT_WIFI:
+                return "WIFI";
+            case BOOT_UPDATE:
+                return "UPDATE";
+            case BOOT_MENUS:
+                return "MENUS";
+            case TOTAL_BOOT_PHASES:
+                break;
+        }
+        return "?";
+    }
+};
@@ -1,9 +1,9 @@
 #pragma once
-#include <Arduino.h>   // for pinMode(), digitalRead(), etc.
-#include <functional>  // for std::function
-#include <vector>      // for std::vector
+#include <Arduino.h>  // for pinMode(), GPI, etc.
 
+#include "delegate.hpp"
 #include "elapsed_time.hpp"
+#include "isr_events.hpp"
 
 enum Pins_e {
     PIN_BTN_UP = 10,
@@ -12,6 +12,25 @@ enum Pins_e {
     PIN_BTN_RIGHT = 14,
 };
 
+enum {
+    BUTTON_PINS_MASK = (1 << PIN_BTN_UP) | (1 << PIN_BTN_DOWN) |
+                       (1 << PIN_BTN_LEFT) | (1 << PIN_BTN_RIGHT),
+};
+
+/**
+ * A button, or a chord of them when it has several pins. Presses are timed
+ * from the edge interrupts rather than from when the main loop gets around
+ * to them: HandleEvent() debounces each edge by its ISR timestamp and queues
+ * the change, and Update() passes the queued changes to the handler in order.
+ * A frame or blocking call that holds up the loop delays a press, but a
+ * press and release that both happen while it is held up are still
+ * delivered, with repeats counted from the time of the press.
+ *
+ * The edges are backed up by a snapshot of the GPIO register, read once per
+ * loop. Should an edge be lost (the event queue filled up, or GPIO0 missed
+ * one while it was busy being the boot strapping pin), the snapshot
+ * corrects the state after the debounce time.
+ * */
 class Button {
   public:
     enum Event_e {
@@ -21,18 +40,41 @@ class Button {
     };
 
   private:
-    std::vector<int> m_pins;  // a Button can have multiple input pins
-    bool m_currentPinState{false};
+    enum {
+        MAX_PENDING = 8,  // changes waiting for Update(), per button
+    };
 
-    bool m_enabled{true};
-    bool m_isPressed{false};
-    bool m_wasPressed{false};
+    struct Change {
+        bool isPressed;
+        uint32_t micros;  // of the edge
+    };
+
+    // bit per GPIO that reads LOW, shared by all buttons. see ReadInputs()
+    inline static uint32_t m_lowPins{0};
+    // edges from before this were already seen by a blocking poll. only
+    // until the events queued by then have been handled
+    inline static bool m_isIgnoringEdges{false};
+    inline static uint32_t m_ignoreEdgesBeforeUs{0};
 
-    ElapsedTime m_timeInState;
-    ElapsedTime m_timeSinceRepeat;
+    inline static uint32_t m_lastLatencyUs{0};
+    inline static uint32_t m_avgLatencyUs8{0};  // 8 times the average
+    inline static uint32_t m_maxLatencyUs{0};
+
+    uint32_t m_pinMask{0};     // a Button can have multiple input pins
+    uint32_t m_edgeLowPins{0};  // its pins that were LOW as of the last edge
+    bool m_isDebouncedPressed{false};
+    uint32_t m_changedAtUs{0};
+
+    Change m_pending[MAX_PENDING];
+    size_t m_pendingHead{0};
+    size_t m_pendingCount{0};
+
+    bool m_enabled{true};
+    bool m_isPressed{false};  // as far as the handler knows
+    uint32_t m_nextRepeatUs{0};
 
   public:
-    using HandlerFunc_t = std::function<void(const Event_e evt)>;
+    using HandlerFunc_t = Delegate<void(const Event_e evt)>;
     struct Config {
         bool canRepeat{true};
 
@@ -46,16 +88,61 @@ class Button {
 
     Button(const int pin, const int inputType) : Button({pin}, inputType) {}
     Button(std::initializer_list<int> pins, const int inputType) {
-        m_pins = pins;
-        for (auto pin : m_pins) {
+        for (auto pin : pins) {
+            m_pinMask |= 1 << pin;
             pinMode(pin, inputType);
+            attachInterruptArg(digitalPinToInterrupt(pin), EdgeISR,
+                               (void*)(intptr_t)pin, CHANGE);
         }
+        m_edgeLowPins = ~GPI & m_pinMask;
+        m_changedAtUs = micros();
+    }
+
+    // called by the main loop for every event drained from IsrEvents
+    void HandleEvent(const IsrEvent& evt) {
+        const uint32_t pinBit = 1 << evt.pin;
+        if (evt.type != IsrEvents::BUTTON_EDGE || !(m_pinMask & pinBit) ||
+            (m_isIgnoringEdges &&
+             (int32_t)(evt.micros - m_ignoreEdgesBeforeUs) < 0)) {
+            return;
+        }
+
+        if (evt.level == LOW) {
+            m_edgeLowPins |= pinBit;
+        } else {
+            m_edgeLowPins &= ~pinBit;
+        }
+        Debounce(m_edgeLowPins == m_pinMask, evt.micros);
+    }
+
+    // one read of the GPIO input register for all buttons, once per loop
+    // after the events are handled and before any Update()
+    static void ReadInputs() {
+        m_lowPins = ~GPI & BUTTON_PINS_MASK;
+        m_isIgnoringEdges = false;
     }
 
     void Update() {
-        if (m_enabled) {
-            CheckForPinStateChange();
-            CheckForEventsToSend();
+        if (!m_enabled) {
+            return;
+        }
+
+        const uint32_t now = micros();
+        if (now - m_changedAtUs >= config.debounceTime * 1000) {
+            m_edgeLowPins = m_lowPins & m_pinMask;
+            Debounce(m_edgeLowPins == m_pinMask, now);
+        }
+
+        SendPendingEvents(now);
+        if (m_isPressed && config.canRepeat &&
+            (int32_t)(now - m_nextRepeatUs) >= 0) {
+            // a loop that was held up doesn't make up for the repeats it
+            // missed
+            m_nextRepeatUs += config.repeatRate * 1000;
+            if ((int32_t)(now - m_nextRepeatUs) >= 0) {
+                m_nextRepeatUs = now + config.repeatRate * 1000;
+            }
+            Send(REPEAT, now);
         }
     }
 
@@ -66,34 +153,45 @@ class Button {
 
     bool IsPressed() { return m_enabled && m_isPressed; }
 
+    // whatever happened so far is forgotten, a button that is still held
+    // is seen as a new press once the debounce time is over
     void Reset() {
-        m_timeInState.Reset();
+        m_pendingCount = 0;
         m_isPressed = false;
-        m_wasPressed = false;
+        m_isDebouncedPressed = false;
+        m_changedAtUs = micros();
     }
 
+    // time from the press edge to its PRESS handler, in microseconds
+    static uint32_t GetLastLatencyUs() { return m_lastLatencyUs; }
+    static uint32_t GetAvgLatencyUs() { return m_avgLatencyUs8 / 8; }
+    static uint32_t GetMaxLatencyUs() { return m_maxLatencyUs; }
+
     static int AreAnyButtonsPressed() {
-        if (digitalRead(PIN_BTN_UP) == LOW) {
-            return PIN_BTN_UP;
-        }
-        if (digitalRead(PIN_BTN_DOWN) == LOW) {
-            return PIN_BTN_DOWN;
-        }
-        if (digitalRead(PIN_BTN_LEFT) == LOW) {
-            return PIN_BTN_LEFT;
-        }
-        if (digitalRead(PIN_BTN_RIGHT) == LOW) {
-            return PIN_BTN_RIGHT;
+        const uint32_t lowPins = ~GPI & BUTTON_PINS_MASK;
+        for (const int pin :
+             {PIN_BTN_UP, PIN_BTN_DOWN, PIN_BTN_LEFT, PIN_BTN_RIGHT}) {
+            if (lowPins & (1 << pin)) {
+                return pin;
+            }
         }
         return -1;
     }
 
+    // for code that polls the buttons itself while it blocks the main loop.
+    // the edges it has acted on shouldn't reach the handlers afterwards
+    static void IgnoreEdgesUntilNow() {
+        m_ignoreEdgesBeforeUs = micros();
+        m_isIgnoringEdges = true;
+    }
+
     static int WaitForButtonPress(const size_t maxWaitMs = 10000) {
         WaitForNoButtons();
         ElapsedTime wait;
         while (true) {
             int button = AreAnyButtonsPressed();
             if (button != -1) {
+                IgnoreEdgesUntilNow();
                 return button;
             }
 
@@ -108,60 +206,89 @@ class Button {
         ElapsedTime wait;
         while (AreAnyButtonsPressed() != -1) {
             if (maxWaitMs && wait.Ms() > maxWaitMs) {
-                return;
+                break;
             }
             yield();
         }
-        return;
+        IgnoreEdgesUntilNow();
     }
 
   private:
-    void CheckForPinStateChange() {
-        if (m_timeInState.Ms() < config.debounceTime) {
-            // do nothing while we're debouncing because this is
-            // when the button can physically bounce.
+    // a change is accepted right away, but anything within debounceTime of
+    // the last accepted change is the button bouncing
+    void Debounce(const bool isPressed, const uint32_t atUs) {
+        if (isPressed == m_isDebouncedPressed ||
+            atUs - m_changedAtUs < config.debounceTime * 1000) {
             return;
         }
+        m_isDebouncedPressed = isPressed;
+        m_changedAtUs = atUs;
 
-        bool lastPinState = m_currentPinState;
-        m_currentPinState = GetCombinedPinState();
-        if (lastPinState != m_currentPinState &&
-            m_currentPinState != m_isPressed) {
-            m_timeInState.Reset();
-            m_isPressed = m_currentPinState;
+        if (m_pendingCount == MAX_PENDING) {
+            // the loop is far behind, keep the latest state
+            m_pendingHead = (m_pendingHead + 1) % MAX_PENDING;
+            m_pendingCount--;
         }
+        m_pending[(m_pendingHead + m_pendingCount++) % MAX_PENDING] = {
+            isPressed, atUs};
     }
 
-    void CheckForEventsToSend() {
-        if (!config.handlerFunc) {
-            return;
-        }
-
-        if (m_isPressed != m_wasPressed) {
-            if (m_isPressed &&
-                m_timeInState.Ms() < config.delayBeforePressEvent) {
-                return;
+    void SendPendingEvents(const uint32_t now) {
+        const uint32_t pressDelayUs = config.delayBeforePressEvent * 1000;
+        while (m_pendingCount) {
+            const Change& change = m_pending[m_pendingHead];
+            if (change.isPressed && pressDelayUs) {
+                if (m_pendingCount > 1) {
+                    // released already, was it held long enough?
+                    const Change& release =
+                        m_pending[(m_pendingHead + 1) % MAX_PENDING];
+                    if (release.micros - change.micros < pressDelayUs) {
+                        PopPending();
+                        PopPending();
+                        continue;
+                    }
+                } else if (now - change.micros < pressDelayUs) {
+                    return;  // still being held, not for long enough yet
+                }
             }
 
-            m_wasPressed = m_isPressed;
-            m_timeSinceRepeat.Reset();
+            const Change sent = change;
+            PopPending();
+            if (sent.isPressed == m_isPressed) {
+                continue;  // a release of a press that was never sent
+            }
 
-            config.handlerFunc(m_isPressed ? PRESS : RELEASE);
-        } else if (m_isPressed &&
-                   (m_timeInState.Ms() >= config.delayBeforeRepeat) &&
-                   (m_timeSinceRepeat.Ms() >= config.repeatRate)) {
-            m_timeSinceRepeat.Reset();
-            if (config.canRepeat) {
-                config.handlerFunc(REPEAT);
+            m_isPressed = sent.isPressed;
+            if (m_isPressed) {
+                m_nextRepeatUs =
+                    sent.micros +
+                    max(config.delayBeforeRepeat, config.repeatRate) * 1000;
             }
+            Send(m_isPressed ? PRESS : RELEASE, sent.micros);
         }
     }
 
-    bool GetCombinedPinState() {
-        bool state = true;
-        for (auto pin : m_pins) {
-            state = state && (digitalRead(pin) == LOW);
+    void PopPending() {
+        m_pendingHead = (m_pendingHead + 1) % MAX_PENDING;
+        m_pendingCount--;
+    }
+
+    void Send(const Event_e evt, const uint32_t edgeMicros) {
+        if (!config.handlerFunc) {
+            return;
         }
-        return state;
+
+        if (evt == PRESS) {
+            m_lastLatencyUs = micros() - edgeMicros;
+            // over roughly the last 8 presses
+            m_avgLatencyUs8 += m_lastLatencyUs - m_avgLatencyUs8 / 8;
+            m_maxLatencyUs = max(m_maxLatencyUs, m_lastLatencyUs);
+        }
+        config.handlerFunc(evt);
     }
-};
\ No newline at end of file
+
+    static void IRAM_ATTR EdgeISR(void* arg) {
+        const int pin = (intptr_t)arg;
+        IsrEvents::Push(IsrEvents::BUTTON_EDGE, pin, digitalRead(pin));
+    }
+};
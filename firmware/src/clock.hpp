@@ -2,6 +2,7 @@
 #include <stdint.h>  // for uint16_t and others
 
 #include "elapsed_time.hpp"
+#include "hot_func.hpp"
 #include "menu.hpp"
 #include "rtc.hpp"
 
@@ -13,17 +14,6 @@ class Clock : public Menu {
         CONF_MODE_ANIM,
     };
 
-    enum AnimationMode_e {
-        ANIM_MODE_NORMAL,
-        ANIM_MODE_SHIMMER,
-        ANIM_MODE_RAINBOW,
-        ANIM_MODE_MARQUEE,
-        ANIM_MODE_MARQUEE_RAINBOW,
-        ANIM_MODE_BINARY,
-        ANIM_MODE_BINARY_SHIMMER,
-        TOTAL_ANIM_MODES,
-    };
-
     enum {
         MARQUEE_DELAY_MS = 125,
     };
@@ -45,10 +35,25 @@ class Clock : public Menu {
 
     int m_marqueePos{0};
 
+    bool m_is24Hour{false};
+    bool m_hasClockBackground{true};
+    bool m_showWiFiStatus{false};
+
   public:
     Clock(Display& display, Rtc& rtc, Settings& settings)
         : Menu(display, settings), m_rtc(rtc) {
+        SetRedrawPeriod(1000 / FRAMES_PER_SECOND);  // always animated
         LoadSettings();
+        m_settings.Subscribe(
+            SettingMask(SETTING_24HR) | SettingMask(SETTING_CLKB) |
+                SettingMask(SETTING_WIFI) | SettingMask(SETTING_WLED),
+            [this](Setting_e) {
+                const SettingValues& values = m_settings.Values();
+                m_is24Hour = values.is24Hour;
+                m_hasClockBackground = values.clockBackground;
+                m_showWiFiStatus =
+                    values.wifi != WIFI_SETTING_OFF && values.wifiStatusLED;
+            });
     }
 
     virtual void Update() {
@@ -117,14 +122,14 @@ class Clock : public Menu {
                 case CONF_MODE_COLORWHEEL:
                     m_configMode = CONF_MODE_COLORWHEEL;
                     m_colorWheelPos -= 4;
-                    m_settings[F("COLR")] = m_colorWheelPos;
+                    m_settings.Set(SETTING_COLR, m_colorWheelPos);
                     break;
 
                 case CONF_MODE_ANIM:
                     if (--m_animMode == -1) {
                         m_animMode = TOTAL_ANIM_MODES - 1;
-                        m_settings[F("MODE")] = m_animMode;
                     }
+                    m_settings.Set(SETTING_MODE, m_animMode);
                     SetMode();
                     break;
 
@@ -146,14 +151,14 @@ class Clock : public Menu {
                     m_configMode = CONF_MODE_ANIM;
                     if (++m_animMode == TOTAL_ANIM_MODES) {
                         m_animMode = ANIM_MODE_NORMAL;
-                        m_settings[F("MODE")] = m_animMode;
                     }
+                    m_settings.Set(SETTING_MODE, m_animMode);
                     SetMode();
                     break;
 
                 case CONF_MODE_COLORWHEEL:
                     m_colorWheelPos += 4;
-                    m_settings[F("COLR")] = m_colorWheelPos;
+                    m_settings.Set(SETTING_COLR, m_colorWheelPos);
                     break;
 
                 default:
@@ -173,7 +178,6 @@ class Clock : public Menu {
 
   private:
     void SetMode(const bool showMessage = true) {
-        using namespace std::placeholders;
         m_display.GetPixels().clearColorOverride();
         m_marqueePos = WIDTH;
 
@@ -185,13 +189,17 @@ class Clock : public Menu {
 
             case ANIM_MODE_SHIMMER:
                 m_display.GetPixels().setColorOverride(
-                    std::bind(&Clock::AddShimmerEffect, this, _1, _2));
+                    [this](const uint16_t num, uint32_t& color) {
+                        AddShimmerEffect(num, color);
+                    });
                 m_configMessage = F("SHIMMER");
                 break;
 
             case ANIM_MODE_RAINBOW:
                 m_display.GetPixels().setColorOverride(
-                    std::bind(&Clock::AddRainbowEffect, this, _1, _2));
+                    [this](const uint16_t num, uint32_t& color) {
+                        AddRainbowEffect(num, color);
+                    });
                 m_configMessage = F("RAINBOW");
                 break;
 
@@ -201,7 +209,9 @@ class Clock : public Menu {
 
             case ANIM_MODE_MARQUEE_RAINBOW:
                 m_display.GetPixels().setColorOverride(
-                    std::bind(&Clock::AddRainbowEffect, this, _1, _2));
+                    [this](const uint16_t num, uint32_t& color) {
+                        AddRainbowEffect(num, color);
+                    });
                 m_configMessage = F("MARQUEE");
                 break;
 
@@ -211,7 +221,9 @@ class Clock : public Menu {
 
             case ANIM_MODE_BINARY_SHIMMER:
                 m_display.GetPixels().setColorOverride(
-                    std::bind(&Clock::AddShimmerEffect, this, _1, _2));
+                    [this](const uint16_t num, uint32_t& color) {
+                        AddShimmerEffect(num, color);
+                    });
                 m_configMessage = F("BIN SHIM");
                 break;
 
@@ -235,7 +247,7 @@ class Clock : public Menu {
         m_display.Clear();
 
         char text[10];
-        if (m_settings[F("24HR")] == F("ON")) {
+        if (m_is24Hour) {
             sprintf(text, "%02d", m_rtc.Hour());
         } else {
             sprintf(text, "%2d", m_rtc.Hour());
@@ -248,7 +260,7 @@ class Clock : public Menu {
     void DrawMarquee() {
         m_display.Clear();
         char text[20];
-        if (m_settings[F("24HR")] == F("ON")) {
+        if (m_is24Hour) {
             sprintf(text, "%02d:%02d:%02d", m_rtc.Hour(), m_rtc.Minute(),
                     m_rtc.Second());
         } else {
@@ -305,7 +317,7 @@ class Clock : public Menu {
             m_display.DrawColorWheel(m_colorWheelPos);
         } else {
             m_display.ClearRoundLEDs(
-                m_settings[F("CLKB")] == F("ON") ? DARK_GRAY : BLACK);
+                m_hasClockBackground ? DARK_GRAY : BLACK);
 
             uint32_t secondColor =
                 Display::ScaleBrightness(m_currentColor, 0.6f);
@@ -344,7 +356,7 @@ class Clock : public Menu {
         m_display.DrawPixel(x, 3, transitionColor, true);
     }
 
-    void AddShimmerEffect(const uint16_t pixelNum, uint32_t& color) {
+    HOT_FUNC void AddShimmerEffect(const uint16_t pixelNum, uint32_t& color) {
         static uint8_t jump = 0;
         static int pixelsChanged = 0;
         static float multiplier = 1.0f;
@@ -374,7 +386,7 @@ class Clock : public Menu {
         }
     }
 
-    void AddRainbowEffect(const uint16_t pixelNum, uint32_t& color) {
+    HOT_FUNC void AddRainbowEffect(const uint16_t pixelNum, uint32_t& color) {
         static uint8_t baseColor = 128;
         static uint8_t curColor = 0;
 
@@ -395,11 +407,7 @@ class Clock : public Menu {
     }
 
     void DrawWiFiStatus() {
-        const bool isWiFiEnabled =
-            m_settings.containsKey("WIFI") && m_settings[F("WIFI")] != F("OFF");
-        const bool isWiFiLEDStatusEnabled =
-            m_settings.containsKey("WLED") && m_settings[F("WLED")] != F("OFF");
-        if (isWiFiEnabled && isWiFiLEDStatusEnabled) {
+        if (m_showWiFiStatus) {
             if (WiFi.isConnected()) {
                 if (m_animMode < ANIM_MODE_BINARY) {
                     // it's fitting that 42 is exactly the right place for
@@ -442,27 +450,8 @@ class Clock : public Menu {
     }
 
     void LoadSettings() {
-        if (!m_settings.containsKey(F("WLED"))) {
-            m_settings[F("WLED")] = F("ON");
-        }
-
-        if (!m_settings.containsKey(F("COLR"))) {
-            m_settings[F("COLR")] = m_colorWheelPos;
-        } else {
-            m_colorWheelPos = m_settings[F("COLR")].as<uint32_t>();
-        }
-
-        if (!m_settings.containsKey(F("MODE"))) {
-            m_settings[F("MODE")] = m_animMode;
-        } else {
-            m_animMode = m_settings[F("MODE")].as<int>();
-            if (m_animMode >= TOTAL_ANIM_MODES) {
-                m_animMode = ANIM_MODE_NORMAL;
-            }
-        }
-
-        if (!m_settings.containsKey(F("CLKB"))) {
-            m_settings[F("CLKB")] = F("ON");
-        }
+        // the settings schema already checked MODE against its range
+        m_colorWheelPos = m_settings.Values().color;
+        m_animMode = m_settings.Values().animMode;
     }
 };
\ No newline at end of file
@@ -1,51 +1,49 @@
 #pragma once
-#include <functional>  // for std::function
-#include <memory>      // for std::shared_ptr
+#include <algorithm>  // for std::max
+#include <new>        // for placement new
 
 #include "elapsed_time.hpp"
 #include "foxie_wifi.hpp"
 #include "menu.hpp"
+#include "menu_tree.hpp"
 #include "option.hpp"
 
+/**
+ * The settings, as pages of MenuItems (see menu_tree.hpp). UP/DOWN move
+ * through a page and the hour LEDs show where we are, twelve entries at a
+ * time, with the outside ring showing which twelve when a page has more.
+ * RIGHT opens the entry: a page, or an Option that is built right then
+ * and freed again when it's done or LEFT closes it.
+ * */
 class ConfigMenu : public Menu {
   protected:
     enum {
-        NOT_SELECTED = -1,
+        RING_SIZE = 12,
     };
 
-    std::vector<std::shared_ptr<Option>> m_options;
+    static constexpr size_t OPTION_SIZE =
+        std::max({sizeof(TextListOption), sizeof(RangeOption),
+                  sizeof(OneShotOption), sizeof(UpdateOption)});
+
+    WebUpdate& m_updater;
+    OneShotOption::RunFunc m_actions[TOTAL_ACTIONS];
+
+    MenuPage_e m_page{PAGE_MAIN};
     size_t m_displayedOption{0};
-    int m_selectedOption{NOT_SELECTED};
+    // the open one, if any, built in m_optionStorage so that opening an
+    // entry doesn't allocate
+    Option* m_option{nullptr};
+    alignas(void*) unsigned char m_optionStorage[OPTION_SIZE];
     ElapsedTime m_sinceStartedShowingOption;
 
   public:
-    ConfigMenu(Display& display, Settings& settings)
-        : Menu(display, settings) {}
-
-    void Add(const std::shared_ptr<Option> option) {
-        m_options.push_back(option);
-    }
-
-    void AddTextSetting(const String name,
-                        const std::vector<String>& values,
-                        const std::function<void()> finishFunc = nullptr) {
-        m_options.push_back(std::make_shared<TextListOption>(
-            m_display, m_settings, name, values, finishFunc));
-    }
+    ConfigMenu(Display& display, Settings& settings, WebUpdate& updater)
+        : Menu(display, settings), m_updater(updater) {}
+    ~ConfigMenu() { CloseOption(); }
 
-    void AddRunFuncSetting(const String name,
-                           const std::function<void()> runFuncOnce,
-                           const std::function<void()> finishFunc = nullptr) {
-        m_options.push_back(
-            std::make_shared<OneShotOption>(name, runFuncOnce, finishFunc));
-    }
-
-    void AddRangeSetting(const String name,
-                         const int min,
-                         const int max,
-                         std::function<void()> finishFunc = nullptr) {
-        m_options.push_back(std::make_shared<RangeOption>(
-            m_display, m_settings, name, min, max, finishFunc));
+    void SetAction(const MenuAction_e action,
+                   const OneShotOption::RunFunc runFuncOnce) {
+        m_actions[action] = runFuncOnce;
     }
 
     virtual void Update() override {
@@ -53,12 +51,14 @@ class ConfigMenu : public Menu {
 
         ShowMenuOptionPositionOnHours();
 
-        if (m_selectedOption >= 0) {
-            m_options[m_selectedOption]->Update();
+        if (m_option) {
+            m_option->Update();
+            if (m_option->IsAnimated()) {
+                RedrawIn(1000 / FRAMES_PER_SECOND);
+            }
 
-            if (m_options[m_selectedOption]->IsDone()) {
-                m_options[m_selectedOption]->Finish();
-                m_selectedOption = NOT_SELECTED;
+            if (m_option->IsDone()) {
+                CloseOption();
             }
         } else {
             ShowCurrentOptionName();
@@ -66,26 +66,43 @@ class ConfigMenu : public Menu {
     }
 
     void ShowCurrentOptionName() {
-        m_display.DrawText(
-            0, m_options[m_displayedOption]->GetName().substring(0, 4), GRAY);
+        m_display.DrawText(0, GetName(GetItem(m_displayedOption)), GRAY);
 
-        if (m_sinceStartedShowingOption.Ms() > 1000) {
+        const size_t shownMs = m_sinceStartedShowingOption.Ms();
+        if (shownMs > 1000) {
             m_display.DrawChar(14, CHAR_RIGHT_ARROW, GREEN);
-        } else if (m_sinceStartedShowingOption.Ms() > 500) {
+        } else if (shownMs > 500) {
             m_display.DrawChar(15, CHAR_RIGHT_ARROW, GREEN);
+            RedrawIn(1001 - shownMs);
+        } else {
+            RedrawIn(501 - shownMs);
         }
     }
 
+    // twelve entries to a ring page, and when the menu page has more than
+    // that, the outside ring shows which ring page we're on
     void ShowMenuOptionPositionOnHours() {
+        const size_t count = GetItemCount();
+        const size_t ringPage = m_displayedOption / RING_SIZE;
+        const size_t first = ringPage * RING_SIZE;
+
         m_display.ClearRoundLEDs();
-        for (size_t i = 0; i < 12; ++i) {
-            if (i < m_options.size()) {
+        for (size_t i = 0; i < RING_SIZE; ++i) {
+            if (first + i < count) {
                 m_display.DrawHourLED(i + 1, DARK_GREEN);
             } else {
                 m_display.DrawHourLED(i + 1, GRAY);
             }
         }
-        m_display.DrawHourLED(m_displayedOption + 1, GREEN);
+        m_display.DrawHourLED(m_displayedOption - first + 1, GREEN);
+
+        if (count > RING_SIZE) {
+            const size_t ringPages = (count + RING_SIZE - 1) / RING_SIZE;
+            for (size_t i = 0; i < ringPages && i < RING_SIZE; ++i) {
+                m_display.DrawOutsideRingPixel(i, GRAY);
+            }
+            m_display.DrawOutsideRingPixel(ringPage, GREEN);
+        }
     }
 
     virtual void Activate() override {
@@ -93,21 +110,24 @@ class ConfigMenu : public Menu {
         m_sinceStartedShowingOption.Reset();
     }
 
+    virtual bool ShouldTimeout() override {
+        return !m_option || m_option->ShouldTimeout();
+    }
+
     virtual void Timeout() override {
-        if (m_selectedOption != NOT_SELECTED) {
-            m_options[m_selectedOption]->Finish();
-            m_selectedOption = NOT_SELECTED;
-        }
+        CloseOption();
+        m_page = PAGE_MAIN;
+        m_displayedOption = 0;
         m_display.ScrollHorizontal(WIDTH, SCROLL_RIGHT);
     }
 
     virtual bool Up(const Button::Event_e evt) override {
         if (evt == Button::PRESS || evt == Button::REPEAT) {
-            if (m_selectedOption >= 0) {
-                m_options[m_selectedOption]->Up();
+            if (m_option) {
+                m_option->Up();
             } else {
                 if (m_displayedOption-- == 0) {
-                    m_displayedOption = m_options.size() - 1;
+                    m_displayedOption = GetItemCount() - 1;
                 }
 
                 m_display.ScrollVertical(HEIGHT, SCROLL_DOWN);
@@ -119,10 +139,10 @@ class ConfigMenu : public Menu {
 
     virtual bool Down(const Button::Event_e evt) override {
         if (evt == Button::PRESS || evt == Button::REPEAT) {
-            if (m_selectedOption >= 0) {
-                m_options[m_selectedOption]->Down();
+            if (m_option) {
+                m_option->Down();
             } else {
-                if (++m_displayedOption == m_options.size()) {
+                if (++m_displayedOption == GetItemCount()) {
                     m_displayedOption = 0;
                 }
 
@@ -136,12 +156,15 @@ class ConfigMenu : public Menu {
     virtual bool Left(const Button::Event_e evt) override {
         if (evt == Button::PRESS) {
             m_display.ScrollHorizontal(WIDTH, SCROLL_RIGHT);
-            if (m_selectedOption >= 0) {
-                m_options[m_selectedOption]->Finish();
-                m_selectedOption = NOT_SELECTED;
+            if (m_option) {
+                CloseOption();
                 m_sinceStartedShowingOption.Reset();
                 return true;
             }
+            if (m_page != PAGE_MAIN) {
+                OpenPage(MENU_PAGES[m_page].parent);
+                return true;
+            }
         }
         // exit the settings menu, MenuManager treats this as
         // moving to the previous Menu
@@ -149,13 +172,75 @@ class ConfigMenu : public Menu {
     }
 
     virtual bool Right(const Button::Event_e evt) override {
-        if (evt == Button::PRESS) {
-            if (m_selectedOption == NOT_SELECTED) {
-                m_display.ScrollHorizontal(WIDTH, SCROLL_LEFT);
-                m_selectedOption = m_displayedOption;
-                m_options[m_selectedOption]->Begin();
-            }
+        if (evt == Button::PRESS && !m_option) {
+            m_display.ScrollHorizontal(WIDTH, SCROLL_LEFT);
+            OpenItem(GetItem(m_displayedOption));
         }
         return true;
     }
+
+  protected:
+    size_t GetItemCount() { return MENU_PAGES[m_page].count; }
+
+    MenuItem GetItem(const size_t index) {
+        MenuItem item;
+        memcpy_P(&item, &MENU_PAGES[m_page].items[index], sizeof(item));
+        return item;
+    }
+
+    String GetName(const MenuItem& item) {
+        if (item.type == MenuItem::SETTING) {
+            return String(SettingsSchema::Get((Setting_e)item.id).key)
+                .substring(0, 4);
+        }
+        return item.name;
+    }
+
+    void OpenPage(const MenuPage_e page) {
+        m_page = page;
+        m_displayedOption = 0;
+        m_sinceStartedShowingOption.Reset();
+    }
+
+    // the Option for an entry only exists while it's open
+    void OpenItem(const MenuItem& item) {
+        switch (item.type) {
+            case MenuItem::SETTING: {
+                // the schema decides between a list of choices and a range
+                // of numbers. whoever depends on the setting subscribes to
+                // it in Settings
+                const Setting_e setting = (Setting_e)item.id;
+                if (SettingsSchema::Get(setting).type == SettingInfo::CHOICE) {
+                    Emplace<TextListOption>(m_display, m_settings, setting);
+                } else {
+                    Emplace<RangeOption>(m_display, m_settings, setting);
+                }
+                break;
+            }
+            case MenuItem::ACTION:
+                Emplace<OneShotOption>(item.name, m_actions[item.id]);
+                break;
+            case MenuItem::UPDATE:
+                Emplace<UpdateOption>(item.name, m_updater);
+                break;
+            case MenuItem::PAGE:
+                OpenPage((MenuPage_e)item.id);
+                return;
+        }
+        m_option->Begin();
+    }
+
+    template <typename T, typename... Args>
+    void Emplace(Args&&... args) {
+        static_assert(alignof(T) <= alignof(void*), "Option alignment");
+        m_option = new (m_optionStorage) T(std::forward<Args>(args)...);
+    }
+
+    void CloseOption() {
+        if (m_option) {
+            m_option->End();
+            m_option->~Option();
+            m_option = nullptr;
+        }
+    }
 };
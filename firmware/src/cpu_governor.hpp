@@ -0,0 +1,160 @@
+#pragma once
+#include <Arduino.h>         // for ESP, millis(), Print
+#include <stdint.h>          // for uint32_t and others
+#include <user_interface.h>  // for system_update_cpu_freq() and others
+
+// why the CPU is running at BOOST_MHZ, any number of these at once
+enum CpuBoost_e : uint8_t {
+    BOOST_UPDATE = 1 << 0,      // TLS handshakes and the firmware download
+    BOOST_WIFI_SETUP = 1 << 1,  // the WiFi config portal
+    BOOST_OTA = 1 << 2,         // ArduinoOTA receiving and flashing
+    BOOST_EFFECTS = 1 << 3,     // a color override runs for every pixel
+};
+
+/**
+ * Runs the CPU at the 80MHz the build is set up for (F_CPU), and at
+ * 160MHz while any CpuBoost_e is set. The display and the RTC need little
+ * of the CPU, so the clock face stays at 80MHz most of the time.
+ *
+ * Some code counts CPU cycles with F_CPU built in: the NeoPixel and I2C
+ * bit-banging. Those hold a BaseFrequency for as long as they run, which
+ * goes back to 80MHz for that time. Anything that times itself with the
+ * cycle counter should use NowUs() instead, which keeps a running total
+ * of microseconds across every switch.
+ * */
+class CpuGovernor {
+  public:
+    enum {
+        BASE_MHZ = 80,
+        BOOST_MHZ = 160,
+    };
+
+    // while in scope, the CPU runs at BASE_MHZ. boosts set or cleared
+    // meanwhile take effect when the last one ends
+    class BaseFrequency {
+      public:
+        BaseFrequency() {
+            if (!m_baseFrequencyDepth++ && m_mhz != BASE_MHZ) {
+                m_baseFrequencySections++;
+                SetMhz(BASE_MHZ);
+            }
+        }
+        ~BaseFrequency() {
+            if (!--m_baseFrequencyDepth) {
+                SetMhz(m_boosts ? BOOST_MHZ : BASE_MHZ);
+            }
+        }
+        BaseFrequency(const BaseFrequency&) = delete;
+        BaseFrequency& operator=(const BaseFrequency&) = delete;
+    };
+
+    // while in scope, boost is set
+    class Boost {
+      private:
+        const CpuBoost_e m_boost;
+
+      public:
+        explicit Boost(const CpuBoost_e boost) : m_boost(boost) {
+            Set(m_boost, true);
+        }
+        ~Boost() { Set(m_boost, false); }
+        Boost(const Boost&) = delete;
+        Boost& operator=(const Boost&) = delete;
+    };
+
+  private:
+    inline static uint8_t m_boosts{0};
+    inline static uint8_t m_mhz{BASE_MHZ};
+
+    // NowUs() is m_usAtSwitch plus the cycles since m_switchCycles at
+    // m_mhz. all three move up on every switch and every NowUs()
+    inline static uint32_t m_switchCycles{0};
+    inline static uint32_t m_usAtSwitch{0};
+    inline static uint32_t m_systemUsAtSwitch{0};  // to count wraps by
+    inline static uint32_t m_switches{0};  // BaseFrequency's not included
+    inline static uint32_t m_baseFrequencySections{0};
+    inline static uint8_t m_baseFrequencyDepth{0};  // nested BaseFrequency
+
+    inline static uint32_t m_boostStartMs{0};
+    inline static uint32_t m_boostedMs{0};
+
+  public:
+    static void Set(const CpuBoost_e boost, const bool isSet) {
+        const bool wasBoosted = m_boosts;
+        m_boosts = isSet ? (m_boosts | boost) : (m_boosts & ~boost);
+        if (m_boosts && !wasBoosted) {
+            m_boostStartMs = millis();
+        } else if (!m_boosts && wasBoosted) {
+            m_boostedMs += millis() - m_boostStartMs;
+        } else {
+            return;
+        }
+        m_switches++;
+        if (!m_baseFrequencyDepth) {
+            SetMhz(m_boosts ? BOOST_MHZ : BASE_MHZ);
+        }
+    }
+
+    // microseconds since boot by the cycle counter, wrapping after ~71
+    // minutes, so subtract two of them for a time. right however many
+    // switches come between, as long as it's called at least once in those
+    // 71 minutes. not for interrupt handlers
+    static uint32_t NowUs() {
+        const uint32_t cycles = ESP.getCycleCount() - m_switchCycles;
+        const uint32_t systemUs = system_get_time();
+        uint32_t us = cycles / m_mhz;
+        uint32_t leftover = cycles % m_mhz;
+
+        // the cycle counter wraps every 26 seconds at 160MHz, e.g. while
+        // the WiFi portal blocks. system_get_time() is coarser, but only
+        // wraps with the total, so it tells how many wraps were missed
+        const int64_t missedCycles =
+            (int64_t)(systemUs - m_systemUsAtSwitch) * m_mhz - cycles;
+        if (missedCycles > INT32_MAX) {
+            const uint64_t wraps = (missedCycles + (1LL << 31)) >> 32;
+            const uint64_t allCycles = (wraps << 32) + cycles;
+            us = allCycles / m_mhz;
+            leftover = allCycles % m_mhz;
+        }
+
+        // the cycles that don't make up a whole microsecond stay behind
+        m_switchCycles += cycles - leftover;
+        m_usAtSwitch += us;
+        m_systemUsAtSwitch = systemUs;
+        return m_usAtSwitch;
+    }
+
+    static uint8_t GetMhz() { return m_mhz; }
+    // times the boosts switched the CPU between BASE_MHZ and BOOST_MHZ
+    static uint32_t GetSwitches() { return m_switches; }
+    // times a BaseFrequency dropped a boosted CPU to BASE_MHZ, which
+    // is once a frame for the display while BOOST_EFFECTS is set
+    static uint32_t GetBaseFrequencySections() {
+        return m_baseFrequencySections;
+    }
+    // time spent boosted since boot, apart from BaseFrequency sections
+    static uint32_t GetBoostedMs() {
+        return m_boostedMs + (m_boosts ? millis() - m_boostStartMs : 0);
+    }
+
+    // "CPU:<mhz>MHZ BOOSTED:<s>S SWITCHES:<n> BASE FREQUENCY:<n>"
+    static void PrintReport(Print& out) {
+        out.println(F("CPU:") + String(m_mhz) + F("MHZ BOOSTED:") +
+                    String(GetBoostedMs() / 1000) + F("S SWITCHES:") +
+                    String(m_switches) + F(" BASE FREQUENCY:") +
+                    String(m_baseFrequencySections));
+    }
+
+  private:
+    static void SetMhz(const uint8_t mhz) {
+        if (mhz == m_mhz) {
+            return;
+        }
+        NowUs();  // the time so far at the old speed
+        // and the part of a microsecond left over, as cycles at the new one
+        const uint32_t now = ESP.getCycleCount();
+        m_switchCycles = now - (now - m_switchCycles) * mhz / m_mhz;
+        m_mhz = mhz;
+        system_update_cpu_freq(mhz);
+    }
+};
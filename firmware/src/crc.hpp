@@ -0,0 +1,17 @@
+#pragma once
+#include <stddef.h>  // for size_t
+#include <stdint.h>  // for uint16_t
+
+// CRC-16/CCITT-FALSE, bitwise. only a handful of bytes are ever checked at
+// a time, so a lookup table isn't worth the flash
+static inline uint16_t Crc16(const uint8_t* data,
+                             const size_t length,
+                             uint16_t crc = 0xFFFF) {
+    for (size_t i = 0; i < length; ++i) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint8_t bit = 0; bit < 8; ++bit) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <Arduino.h>         // for noInterrupts(), Print
+#include <stdint.h>          // for uint32_t and others
+#include <user_interface.h>  // for ESP-specific API calls
+
+#include "cpu_governor.hpp"
+#include "delegate.hpp"
+
+// every place that turns interrupts off, for CriticalSection's stats
+enum CriticalSite_e : uint8_t {
+    CRITICAL_DISPLAY_SHOW,
+    CRITICAL_ADC_READ,
+    TOTAL_CRITICAL_SITES,
+};
+
+/**
+ * Turns interrupts (and the soft watchdog) off for as long as it's in
+ * scope, and keeps count of how often and for how long, per site. While
+ * interrupts are off, WiFi, the RTC tick and the buttons all wait, so
+ * these are the numbers to look at when tuning FRAMES_PER_SECOND or the
+ * light sensor's sampling.
+ *
+ * An alert can be set up to be called, with interrupts back on, whenever
+ * a section takes longer than a threshold. PrintReport() is part of the
+ * 't' and /trace report.
+ * */
+class CriticalSection {
+  public:
+    struct Stats {
+        uint32_t count;
+        // SHOW is ~3.3ms of each of 30 frames a second, ~100ms a second,
+        // which would wrap 32 bits of microseconds in about 12 hours
+        uint64_t totalUs;
+        uint32_t maxUs;
+        uint32_t alerts;  // times it took longer than the alert threshold
+    };
+
+    using AlertFunc = Delegate<void(CriticalSite_e site, uint32_t us)>;
+
+  private:
+    inline static Stats m_stats[TOTAL_CRITICAL_SITES]{};
+    inline static uint32_t m_alertThresholdUs{0};
+    inline static AlertFunc m_alert;
+
+    const CriticalSite_e m_site;
+    uint32_t m_startUs;
+
+  public:
+    explicit CriticalSection(const CriticalSite_e site) : m_site(site) {
+        system_soft_wdt_stop();
+        ets_intr_lock();
+        noInterrupts();
+        m_startUs = CpuGovernor::NowUs();
+    }
+
+    ~CriticalSection() {
+        const uint32_t us = CpuGovernor::NowUs() - m_startUs;
+        interrupts();
+        ets_intr_unlock();
+        system_soft_wdt_restart();
+
+        Stats& stats = m_stats[m_site];
+        stats.count++;
+        stats.totalUs += us;
+        stats.maxUs = max(stats.maxUs, us);
+        if (m_alertThresholdUs && us > m_alertThresholdUs) {
+            stats.alerts++;
+            if (m_alert) {
+                m_alert(m_site, us);
+            }
+        }
+    }
+
+    CriticalSection(const CriticalSection&) = delete;
+    CriticalSection& operator=(const CriticalSection&) = delete;
+
+    // 0 turns the alert off. alert may be empty, to only count them
+    static void SetAlert(const uint32_t thresholdUs, const AlertFunc alert) {
+        m_alertThresholdUs = thresholdUs;
+        m_alert = alert;
+    }
+
+    static const Stats& GetStats(const CriticalSite_e site) {
+        return m_stats[site];
+    }
+
+    // "<site> COUNT:<n> TOTAL:<ms>MS MAX:<us>US ALERTS:<n>", one per site
+    static void PrintReport(Print& out) {
+        for (size_t i = 0; i < TOTAL_CRITICAL_SITES; ++i) {
+            const Stats& stats = m_stats[i];
+            out.println(String(GetName((CriticalSite_e)i)) + F(" COUNT:") +
+                        String(stats.count) + F(" TOTAL:") +
+                        String((uint32_t)(stats.totalUs / 1000)) +
+                        F("MS MAX:") + String(stats.maxUs) + F("US ALERTS:") +
+                        String(stats.alerts));
+        }
+    }
+
+    static const char* GetName(const CriticalSite_e site) {
+        switch (site) {
+            case CRITICAL_DISPLAY_SHOW:
+                return "SHOW";
+            case CRITICAL_ADC_READ:
+                return "ADC";
+            case TOTAL_CRITICAL_SITES:
+                break;
+        }
+        return "?";
+    }
+};
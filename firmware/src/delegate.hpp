@@ -0,0 +1,55 @@
+#pragma once
+#include <stddef.h>     // for size_t
+#include <new>          // for placement new
+#include <type_traits>  // for std::is_trivially_copyable and others
+#include <utility>      // for std::forward
+
+template <typename Signature, size_t Capacity = 2 * sizeof(void*)>
+class Delegate;
+
+/**
+ * A callable like std::function that never allocates: the lambda or
+ * function pointer is kept inside the Delegate itself. A lambda that
+ * captures more than Capacity bytes doesn't compile, so give the Delegate
+ * more room or capture less.
+ *
+ * Only trivially copyable callables are allowed (captures of `this`,
+ * references and plain values), which is what keeps a Delegate as cheap to
+ * copy as a couple of pointers.
+ * */
+template <typename R, typename... Args, size_t Capacity>
+class Delegate<R(Args...), Capacity> {
+  private:
+    using Invoke_t = R (*)(void* storage, Args... args);
+
+    alignas(void*) unsigned char m_storage[Capacity];
+    Invoke_t m_invoke{nullptr};
+
+  public:
+    Delegate() = default;
+    Delegate(std::nullptr_t) {}
+
+    template <typename Func,
+              typename = typename std::enable_if<!std::is_same<
+                  typename std::decay<Func>::type,
+                  Delegate>::value>::type>
+    Delegate(Func func) {
+        static_assert(sizeof(Func) <= Capacity,
+                      "captures too much for this Delegate");
+        static_assert(alignof(Func) <= alignof(void*),
+                      "alignment too large for this Delegate");
+        static_assert(std::is_trivially_copyable<Func>::value,
+                      "only captures of pointers, references and values");
+        new (m_storage) Func(func);
+        m_invoke = [](void* storage, Args... args) -> R {
+            return (*static_cast<Func*>(storage))(std::forward<Args>(args)...);
+        };
+    }
+
+    R operator()(Args... args) const {
+        return m_invoke(const_cast<unsigned char*>(m_storage),
+                        std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const { return m_invoke != nullptr; }
+};
@@ -1,11 +1,14 @@
 #pragma once
 #include <Adafruit_NeoPixel.h>  // for communication with WS2812B LEDs
-#include <functional>           // for std::function
 #include <map>                  // for std::map
 #include <vector>               // for std::vector
 
 #include "button.hpp"
+#include "cpu_governor.hpp"
+#include "critical_section.hpp"
+#include "delegate.hpp"
 #include "elapsed_time.hpp"
+#include "hot_func.hpp"
 #include "light_sensor.hpp"
 #include "settings.hpp"
 
@@ -50,19 +53,23 @@ enum Display_e {
     FIRST_MINUTE_LED = FIRST_HOUR_LED + 12,
     TOTAL_LEDS = (WIDTH * HEIGHT) + ROUND_LEDS,
 
-    MIN_BRIGHTNESS = 4,
-    MIN_BRIGHTNESS_DEFAULT = 8,
-    MAX_BRIGHTNESS = 150,
-    MAX_BRIGHTNESS_DEFAULT = 70,
     SCROLLING_TEXT_MS = 50,
     SCROLL_DELAY_HORIZONTAL_MS = 10,
     SCROLL_DELAY_VERTICAL_MS = 20,
     FRAMES_PER_SECOND = 30,
+    FRAME_STATS_FRAMES = FRAMES_PER_SECOND * 10,
     LIGHT_SENSOR_UPDATE_MS = 2,
     LEDS_PIN = 15,
 };
 
 class Display {
+  public:
+    struct FrameStats {
+        uint32_t avgUs;
+        uint32_t minUs;
+        uint32_t maxUs;
+    };
+
   private:
     // Adafruit_NeoPixel::setBrightness() is destructive to the pixel
     // data, pixel read operations at low brightness behave poorly. Having this
@@ -71,14 +78,18 @@ class Display {
     // to intercept setPixelColor calls to change the color of any pixels.
     // the override functionality is used by the rainbow and shimmer effects.
     class PixelsWithBuffer : public Adafruit_NeoPixel {
+      public:
+        using ColorOverrideFunc = Delegate<void(uint16_t num, uint32_t&)>;
+
+      private:
         using Adafruit_NeoPixel::Adafruit_NeoPixel;
         uint32_t m_pixels[TOTAL_LEDS] = {0};
-        std::function<void(uint16_t num, uint32_t&)> m_colorOverrideFunc;
+        ColorOverrideFunc m_colorOverrideFunc;
 
       public:
-        void setPixelColor(const uint16_t num,
-                           uint32_t color,
-                           bool forceColor = false) {
+        HOT_FUNC void setPixelColor(const uint16_t num,
+                                    uint32_t color,
+                                    bool forceColor = false) {
             if (num >= TOTAL_LEDS) {
                 return;
             }
@@ -95,11 +106,14 @@ class Display {
                 ((Adafruit_NeoPixel*)this)->setPixelColor(i, m_pixels[i]);
             }
         }
-        void setColorOverride(
-            std::function<void(const uint16_t num, uint32_t&)> func) {
+        void setColorOverride(const ColorOverrideFunc func) {
             m_colorOverrideFunc = func;
+            CpuGovernor::Set(BOOST_EFFECTS, true);
+        }
+        void clearColorOverride() {
+            m_colorOverrideFunc = nullptr;
+            CpuGovernor::Set(BOOST_EFFECTS, false);
         }
-        void clearColorOverride() { m_colorOverrideFunc = nullptr; }
         uint32_t getPixelColor(uint16_t num) { return m_pixels[num]; }
     };
 
@@ -107,11 +121,22 @@ class Display {
 
     PixelsWithBuffer m_pixels{TOTAL_LEDS, LEDS_PIN, NEO_GRB + NEO_KHZ800};
     LightSensor m_lightSensor;
+    uint8_t m_minBrightness{MIN_BRIGHTNESS_DEFAULT};
+    uint8_t m_maxBrightness{MAX_BRIGHTNESS_DEFAULT};
     size_t m_currentBrightness{0};
     size_t m_lastBrightness{0};
     ElapsedTime m_sinceLastShow;
     ElapsedTime m_sinceLastLightSensorUpdate;
 
+    // intervals between frames shown by Update(), the last window's are
+    // in the trace report
+    uint32_t m_lastFrameUs{0};
+    uint32_t m_windowFrames{0};
+    uint32_t m_windowTotalUs{0};
+    uint32_t m_windowMinUs{UINT32_MAX};
+    uint32_t m_windowMaxUs{0};
+    FrameStats m_frameStats{};
+
   public:
     Display(Settings& settings) : m_settings(settings) {
         m_pixels.begin();
@@ -120,12 +145,12 @@ class Display {
         pinMode(LED_BUILTIN, OUTPUT);
         digitalWrite(LED_BUILTIN, HIGH);
 
-        if (!settings.containsKey(F("MINB"))) {
-            settings[F("MINB")] = String(MIN_BRIGHTNESS_DEFAULT);
-        }
-        if (!settings.containsKey(F("MAXB"))) {
-            settings[F("MAXB")] = String(MAX_BRIGHTNESS_DEFAULT);
-        }
+        settings.Subscribe(
+            SettingMask(SETTING_MINB) | SettingMask(SETTING_MAXB),
+            [this](Setting_e) {
+                m_minBrightness = m_settings.Values().minBrightness;
+                m_maxBrightness = m_settings.Values().maxBrightness;
+            });
     }
 
     PixelsWithBuffer& GetPixels() { return m_pixels; };
@@ -134,12 +159,10 @@ class Display {
         if (m_sinceLastLightSensorUpdate.Ms() > LIGHT_SENSOR_UPDATE_MS) {
             m_sinceLastLightSensorUpdate.Reset();
 
-            const int minBrightness = m_settings[F("MINB")].as<int>();
-            const int maxBrightness = m_settings[F("MAXB")].as<int>();
-
             m_currentBrightness =
                 map(m_lightSensor.Get(), LightSensor::MIN_SENSOR_VAL,
-                    LightSensor::MAX_SENSOR_VAL, minBrightness, maxBrightness);
+                    LightSensor::MAX_SENSOR_VAL, m_minBrightness,
+                    m_maxBrightness);
         }
 
         if (m_sinceLastShow.Ms() > (1000 / FRAMES_PER_SECOND) || force) {
@@ -150,19 +173,18 @@ class Display {
                 m_lastBrightness = m_currentBrightness;
             }
             Show();
+            UpdateFrameStats(force);
         }
     }
 
-    void Show() {
-        system_soft_wdt_stop();
-        ets_intr_lock();
-        noInterrupts();
+    // how evenly frames were shown, over the last FRAME_STATS_FRAMES
+    const FrameStats& GetFrameStats() { return m_frameStats; }
 
+    void Show() {
+        // the NeoPixel timing is counted in cycles at F_CPU
+        CpuGovernor::BaseFrequency baseFrequency;
+        CriticalSection critical(CRITICAL_DISPLAY_SHOW);
         m_pixels.show();
-
-        interrupts();
-        ets_intr_unlock();
-        system_soft_wdt_restart();
     }
 
     void Clear(const uint32_t color = BLACK,
@@ -184,10 +206,10 @@ class Display {
     // effects) will not be called for this pixel and thus cannot change its
     // color. otherwise, the current colorOverrideFunc can change any pixel
     // at will. fun!
-    void DrawPixel(const int x,
-                   const int y,
-                   const uint32_t color,
-                   const bool forceColor = false) {
+    HOT_FUNC void DrawPixel(const int x,
+                            const int y,
+                            const uint32_t color,
+                            const bool forceColor = false) {
         m_pixels.setPixelColor(y * WIDTH + x, color, forceColor);
     }
 
@@ -240,15 +262,29 @@ class Display {
             size_t adjustedDelay = delayMs;
             while (waitToScroll.Ms() < adjustedDelay) {
                 Update(true);
-                adjustedDelay = Button::AreAnyButtonsPressed() != -1
-                                    ? delayMs / 3
-                                    : delayMs;
+                if (Button::AreAnyButtonsPressed() != -1) {
+                    // the press is used up here, not by the menus
+                    Button::IgnoreEdgesUntilNow();
+                    adjustedDelay = delayMs / 3;
+                } else {
+                    adjustedDelay = delayMs;
+                }
                 yield();
             }
             --i;
         }
     }
 
+    // one frame of DrawTextScrolling, for callers that can't block. returns
+    // false once the text has scrolled off the display
+    bool DrawTextScrollingFrame(const String& text,
+                                const uint32_t color,
+                                const size_t elapsedMs,
+                                const size_t delayMs = SCROLLING_TEXT_MS) {
+        const int x = WIDTH - (int)(elapsedMs / delayMs);
+        return x > -DrawText(x, text, color);
+    }
+
     void ScrollHorizontal(const int numColumns,
                           const int direction,
                           const size_t delayMs = SCROLL_DELAY_HORIZONTAL_MS) {
@@ -331,7 +367,7 @@ class Display {
         }
     }
 
-    static uint32_t ColorWheel(uint8_t pos) {
+    HOT_FUNC static uint32_t ColorWheel(uint8_t pos) {
         pos = 255 - pos;
         if (pos < 85) {
             return Adafruit_NeoPixel::Color(255 - pos * 3, 0, pos * 3);
@@ -356,7 +392,8 @@ class Display {
         return GetBrightness() == LightSensor::MIN_SENSOR_VAL;
     }
 
-    static int ScaleBrightness(const uint32_t color, const float brightness) {
+    HOT_FUNC static int ScaleBrightness(const uint32_t color,
+                                        const float brightness) {
         const float r = ((color & 0xFF0000) >> 16) * brightness;
         const float g = ((color & 0x00FF00) >> 8) * brightness;
         const float b = (color & 0x0000FF) * brightness;
@@ -376,6 +413,25 @@ class Display {
         }
     }
 
+    void UpdateFrameStats(const bool force) {
+        const uint32_t now = micros();
+        // forced frames (e.g. scrolling text) don't keep to the frame rate
+        if (m_lastFrameUs && !force) {
+            const uint32_t intervalUs = now - m_lastFrameUs;
+            m_windowFrames++;
+            m_windowTotalUs += intervalUs;
+            m_windowMinUs = min(m_windowMinUs, intervalUs);
+            m_windowMaxUs = max(m_windowMaxUs, intervalUs);
+            if (m_windowFrames == FRAME_STATS_FRAMES) {
+                m_frameStats = {m_windowTotalUs / m_windowFrames,
+                                m_windowMinUs, m_windowMaxUs};
+                m_windowFrames = m_windowTotalUs = m_windowMaxUs = 0;
+                m_windowMinUs = UINT32_MAX;
+            }
+        }
+        m_lastFrameUs = force ? 0 : now;
+    }
+
     void MoveHorizontal(const int num) {
         for (int row = 0; row < HEIGHT; ++row) {
             if (num < 0) {
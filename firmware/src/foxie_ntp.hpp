@@ -1,76 +1,236 @@
 #pragma once
-#include <NTPClient.h>
-#include <WiFiUdp.h>
+#include <ESP8266WiFi.h>
 
 #include "elapsed_time.hpp"
+#include "ntp_poll_scheduler.hpp"
+#include "ntp_selector.hpp"
+#include "ntp_server.hpp"
 #include "rtc.hpp"
 #include "settings.hpp"
+#include "sntp.hpp"
+#include "timezone.hpp"
 
 class FoxieNTP {
   private:
     enum {
-        ONE_SECOND = 1000,
-        ONE_MINUTE = 60000,
+        TEN_MINUTES = 600000,
         WAIT_TO_INITIALIZE = 4000,
-        UTC_ZERO = 0,
+        REPLY_TIMEOUT_MS = 1500,
+        SET_TOLERANCE_MS = 10,   // leave the RTC alone if it's this close
+        PRESET_LEAD_US = 20000,  // how long before starting the RTC to load it
+        SECONDS_PER_DAY = 86400,
+        MS_PER_DAY = SECONDS_PER_DAY * 1000,
+    };
+
+    enum State_e {
+        IDLE,
+        WAITING_FOR_REPLY,
+        WAITING_TO_SET_RTC,
+    };
+
+    // queried one after another, each poll. NIST asks clients not to send
+    // it more than one request every 4 seconds, so there are no bursts
+    static constexpr const char* NTP_SERVERS[NtpSelector::MAX_SAMPLES] = {
+        "time.nist.gov",
+        "0.pool.ntp.org",
+        "1.pool.ntp.org",
+        "time.cloudflare.com",
     };
 
     Settings& m_settings;
     Rtc& m_rtc;
-    WiFiUDP m_udp;
-    NTPClient m_ntpClient{m_udp, "time.nist.gov", UTC_ZERO, int(ONE_MINUTE)};
+    Sntp m_sntp;
+    NtpServer m_servers[NtpSelector::MAX_SAMPLES];
+    NtpSelector m_selector;
+    size_t m_server{0};  // the one being queried during a poll
+    NtpPollScheduler m_poller;
+    TimeZone m_timeZone;
+    int64_t m_nextTransition{0};  // UTC seconds of the next DST change
 
+    State_e m_state{IDLE};
     ElapsedTime m_sinceLastUpdate;
-
-    bool m_isInitialized{false};
+    ElapsedTime m_sinceRequest;
     bool m_ntpSynced{false};
-    size_t m_updateRTCInterval{ONE_SECOND};
+    size_t m_pollInterval{WAIT_TO_INITIALIZE};
+
+    Sntp::Sample m_sample;
+    unsigned long m_millisAtSample{0};
+    int32_t m_lastOffsetMs{0};
+
+    uint32_t m_startRTCAtMicros{0};
+    uint32_t m_presetSecondOfDay{0};
 
   public:
-    FoxieNTP(Settings& settings, Rtc& rtc) : m_settings(settings), m_rtc(rtc) {}
+    FoxieNTP(Settings& settings, Rtc& rtc) : m_settings(settings), m_rtc(rtc) {
+        for (size_t i = 0; i < NtpSelector::MAX_SAMPLES; ++i) {
+            m_servers[i] = NtpServer(NTP_SERVERS[i]);
+        }
+
+        m_settings.Subscribe(SettingMask(SETTING_TZ), [this](Setting_e) {
+            m_timeZone.Compile(
+                TIME_ZONE_PRESETS[m_settings.Values().timeZone].posix);
+            UpdateRTCTime();
+        });
+    }
 
     void Update() {
-        if (WiFi.isConnected()) {
-            if (!m_isInitialized) {
-                m_ntpClient.begin();
-                m_isInitialized = true;
-            } else {
-                if (m_ntpSynced) {
-                    m_ntpClient.update();
-                } else if (m_sinceLastUpdate.Ms() > WAIT_TO_INITIALIZE) {
-                    // check every few seconds until our first sync,
-                    // then sync once per minute
+        switch (m_state) {
+            case IDLE:
+                if (m_nextTransition &&
+                    UtcMicrosAt(micros()) / 1000000 >= m_nextTransition) {
+                    // DST started or ended, the RTC holds local time
+                    UpdateRTCTime();
+                } else if (!WiFi.isConnected()) {
+                    m_sinceLastUpdate.Reset();
+                } else if (m_sinceLastUpdate.Ms() >= m_pollInterval) {
+                    // check every few seconds until our first sync, after
+                    // that the poll scheduler decides
                     m_sinceLastUpdate.Reset();
-                    if (m_ntpClient.update()) {
-                        m_ntpSynced = true;
-                        m_updateRTCInterval = ONE_MINUTE;
-                        UpdateRTCTime();
+                    m_selector.Clear();
+                    m_server = 0;
+                    QueryNextServer();
+                }
+                break;
+
+            case WAITING_FOR_REPLY: {
+                Sntp::Sample sample;
+                if (m_sntp.Receive(sample)) {
+                    if (m_servers[m_server].Accept(sample)) {
+                        m_selector.Add(sample);
                     }
+                    m_server++;
+                    QueryNextServer();
+                } else if (m_sinceRequest.Ms() > REPLY_TIMEOUT_MS) {
+                    m_servers[m_server].AddMiss();
+                    m_server++;
+                    QueryNextServer();
                 }
+                break;
             }
 
-            if (m_sinceLastUpdate.Ms() >= m_updateRTCInterval &&
-                m_ntpSynced == true) {
-                m_sinceLastUpdate.Reset();
-                UpdateRTCTime();
-            }
-        } else {
-            m_sinceLastUpdate.Reset();
+            case WAITING_TO_SET_RTC:
+                SetRTCOnSecondBoundary();
+                break;
         }
     }
 
+    // compares the RTC to the NTP time and, if it is off, schedules the RTC
+    // to be set so that its next second starts exactly on time
     void UpdateRTCTime() {
-        const int offset = m_settings.containsKey("UTC")
-                               ? m_settings["UTC"].as<int>()
-                               : UTC_ZERO;
+        if (!m_ntpSynced) {
+            return;
+        }
 
-        m_ntpClient.setTimeOffset(offset * 60 * 60);
+        const int32_t rtcSecondOfDay =
+            (m_rtc.Hour24() * 60 + m_rtc.Minute()) * 60 + m_rtc.Second();
+        const int32_t rtcMs = rtcSecondOfDay * 1000 + m_rtc.Millis();
+        const uint32_t nowMicros = micros();
+        const int32_t ntpMs = LocalMicrosAt(nowMicros) / 1000 % MS_PER_DAY;
+        m_nextTransition =
+            m_timeZone.GetNextTransition(UtcMicrosAt(nowMicros) / 1000000);
+        int32_t offsetMs = ntpMs - rtcMs;
+        if (offsetMs > MS_PER_DAY / 2) {
+            offsetMs -= MS_PER_DAY;
+        } else if (offsetMs < -MS_PER_DAY / 2) {
+            offsetMs += MS_PER_DAY;
+        }
+        m_lastOffsetMs = offsetMs;
 
-        if (m_ntpClient.getHours() != m_rtc.Hour() ||
-            m_ntpClient.getMinutes() != m_rtc.Minute() ||
-            m_ntpClient.getSeconds() != m_rtc.Second()) {
-            m_rtc.SetTime(m_ntpClient.getHours(), m_ntpClient.getMinutes(),
-                          m_ntpClient.getSeconds());
+        if (abs(offsetMs) > SET_TOLERANCE_MS) {
+            ScheduleRTCSet(nowMicros);
         }
     }
-};
\ No newline at end of file
+
+    bool IsSynced() { return m_ntpSynced; }
+    int32_t GetLastOffsetMs() { return m_lastOffsetMs; }
+    uint32_t GetLastDelayMs() { return m_sample.delayUs / 1000; }
+    NtpPollScheduler& GetPollScheduler() { return m_poller; }
+    NtpSelector& GetSelector() { return m_selector; }
+    NtpServer& GetServer(const size_t index) { return m_servers[index]; }
+
+  private:
+    // servers that can't be looked up or sent to are skipped. once every
+    // server had its turn, the samples that came back are combined
+    void QueryNextServer() {
+        for (; m_server < NtpSelector::MAX_SAMPLES; ++m_server) {
+            IPAddress address;
+            if (m_servers[m_server].Resolve(address) &&
+                m_sntp.Send(address)) {
+                m_sinceRequest.Reset();
+                m_state = WAITING_FOR_REPLY;
+                return;
+            }
+        }
+
+        m_state = IDLE;
+        if (m_selector.Select(m_sample)) {
+            // the chosen sample may have come in a few seconds ago
+            m_millisAtSample =
+                millis() - (micros() - m_sample.localMicros) / 1000;
+            m_ntpSynced = true;
+            UpdateRTCTime();
+
+            m_poller.AddSample(m_lastOffsetMs, GetLastDelayMs());
+            m_pollInterval = m_poller.GetIntervalMs();
+        } else if (m_ntpSynced) {
+            m_poller.AddTimeout();
+        }
+    }
+
+    void ScheduleRTCSet(const uint32_t nowMicros) {
+        // after the RTC is started, its first tick comes
+        // FIRST_TICK_AFTER_START_US later. pick the first whole second we can
+        // still make, and start the RTC that long before it.
+        const int64_t nowUs = LocalMicrosAt(nowMicros);
+        const int64_t earliestTickUs =
+            nowUs + PRESET_LEAD_US + Pcf8563::FIRST_TICK_AFTER_START_US;
+        const int64_t tickUs = (earliestTickUs / 1000000 + 1) * 1000000;
+        const int64_t startUs = tickUs - Pcf8563::FIRST_TICK_AFTER_START_US;
+
+        m_startRTCAtMicros = nowMicros + (uint32_t)(startUs - nowUs);
+        // the RTC holds the preset time until the tick, then advances to the
+        // second that starts at tickUs
+        m_presetSecondOfDay = (tickUs / 1000000 - 1) % SECONDS_PER_DAY;
+        m_state = WAITING_TO_SET_RTC;
+    }
+
+    void SetRTCOnSecondBoundary() {
+        const int32_t remaining = m_startRTCAtMicros - micros();
+        if (remaining > PRESET_LEAD_US) {
+            return;
+        }
+
+        if (remaining < 0) {
+            // the main loop was held up and we missed it, try the next second
+            ScheduleRTCSet(micros());
+            return;
+        }
+
+        m_rtc.PresetTime(m_presetSecondOfDay / 3600,
+                         (m_presetSecondOfDay / 60) % 60,
+                         m_presetSecondOfDay % 60);
+
+        // close enough now that a busy wait is the most precise option
+        while ((int32_t)(m_startRTCAtMicros - micros()) > 0) {
+        }
+        m_rtc.StartClock();
+        m_poller.RTCWasSet();
+        m_state = IDLE;
+    }
+
+    // UTC in microseconds since 1970, extrapolated from the last sample
+    int64_t UtcMicrosAt(const uint32_t nowMicros) {
+        // micros() wraps every ~71 minutes, so only use it for recent samples
+        const unsigned long sinceSample = millis() - m_millisAtSample;
+        if (sinceSample < TEN_MINUTES) {
+            const uint32_t sinceSampleUs = nowMicros - m_sample.localMicros;
+            return m_sample.utcUs + sinceSampleUs;
+        }
+        return m_sample.utcUs + (int64_t)sinceSample * 1000;
+    }
+
+    int64_t LocalMicrosAt(const uint32_t nowMicros) {
+        const int64_t utcUs = UtcMicrosAt(nowMicros);
+        return utcUs + (int64_t)m_timeZone.GetOffset(utcUs / 1000000) * 1000000;
+    }
+};
@@ -3,14 +3,18 @@
 #include <ESP8266WiFi.h>
 #include <ESP8266mDNS.h>
 #include <ESPAsyncWiFiManager.h>
-#include <memory>
 
 #include "button.hpp"
+#include "cpu_governor.hpp"
 #include "display.hpp"
 #include "elapsed_time.hpp"
+#include "delegate.hpp"
 #include "settings.hpp"
 
 class FoxieWiFi {
+  public:
+    using ReportFunc = Delegate<void(Print& out)>;
+
   private:
     enum {
         WAIT_TO_INIT_MS = 2000,
@@ -19,24 +23,35 @@ class FoxieWiFi {
     Settings& m_settings;
     Display& m_display;
 
-    std::shared_ptr<AsyncWebServer> m_server;
-    std::shared_ptr<DNSServer> m_dns;
-    std::shared_ptr<AsyncWiFiManager> m_wifiManager;
+    // in this order, m_wifiManager is given the other two
+    AsyncWebServer m_server{80};
+    DNSServer m_dns;
+    AsyncWiFiManager m_wifiManager{&m_server, &m_dns};
 
     bool m_isInitialized{false};
     bool m_isOTAInitialized{false};
+    bool m_isServerStarted{false};
+
+    WiFiSetting_e m_wifiSetting{WIFI_SETTING_OFF};
+    bool m_isWiFiConfigured{false};
+    bool m_isDeveloperMode{false};
 
     ElapsedTime m_waitToInitialize;
 
   public:
     FoxieWiFi(Settings& settings, Display& display)
         : m_settings(settings), m_display(display) {
-        m_server = std::make_shared<AsyncWebServer>(80);
-        m_dns = std::make_shared<DNSServer>();
-        m_wifiManager =
-            std::make_shared<AsyncWiFiManager>(m_server.get(), m_dns.get());
-        String value = m_settings[F("WIFI")] | "OFF";
-        if (value == "OFF") {
+        m_settings.Subscribe(SettingMask(SETTING_WIFI) |
+                                 SettingMask(SETTING_WIFI_CONFIGURED) |
+                                 SettingMask(SETTING_DEVL),
+                             [this](Setting_e) {
+                                 const SettingValues& values =
+                                     m_settings.Values();
+                                 m_wifiSetting = values.wifi;
+                                 m_isWiFiConfigured = values.isWiFiConfigured;
+                                 m_isDeveloperMode = values.developerMode;
+                             });
+        if (m_wifiSetting == WIFI_SETTING_OFF) {
             WiFi.forceSleepBegin();
         }
     }
@@ -44,26 +59,26 @@ class FoxieWiFi {
     void Update() {
         if (!m_isInitialized) {
             Initialize();
-        } else if (m_settings[F("WIFI")] == "CFG" ||
-                   (m_settings[F("WIFI")] == "ON" &&
-                    m_settings[F("wifi_configured")] != F("1"))) {
+        } else if (m_wifiSetting == WIFI_SETTING_CFG ||
+                   (m_wifiSetting == WIFI_SETTING_ON && !m_isWiFiConfigured)) {
             Configure();
-        } else if (m_settings[F("WIFI")] == F("OFF") && m_isInitialized) {
+        } else if (m_wifiSetting == WIFI_SETTING_OFF && m_isInitialized) {
             WiFi.forceSleepBegin();
             m_isInitialized = false;
             m_isOTAInitialized = false;
-        } else if (WiFi.isConnected() && m_settings[F("WIFI")] == F("OFF")) {
+        } else if (WiFi.isConnected() && m_wifiSetting == WIFI_SETTING_OFF) {
             WiFi.disconnect();
-            m_settings.remove("wifi_configured");
+            m_settings.Set(SETTING_WIFI_CONFIGURED, false);
         }
 
         if (m_isInitialized && WiFi.isConnected() && !m_isOTAInitialized &&
-            m_settings[F("DEVL")] == F("ON")) {
+            m_isDeveloperMode) {
             MDNS.begin(GetUniqueMDNSName().c_str());
             InitializeOTA();
+            StartServer();
         }
 
-        if (m_isOTAInitialized && m_settings[F("DEVL")] == F("ON")) {
+        if (m_isOTAInitialized && m_isDeveloperMode) {
             ArduinoOTA.handle();
             MDNS.update();
             // server.handleClient();
@@ -72,43 +87,54 @@ class FoxieWiFi {
 
     static bool IsConfigured() { return !WiFi.SSID().isEmpty(); }
 
+    // serves http://<clock><path> as text/plain, written by func
+    void AddReportPage(const char* path, const ReportFunc func) {
+        m_server.on(path, HTTP_GET, [func](AsyncWebServerRequest* request) {
+            AsyncResponseStream* response =
+                request->beginResponseStream(F("text/plain"));
+            func(*response);
+            request->send(response);
+        });
+    }
+
   private:
     void Configure() {
         // TODO: Make sure config portal isn't open when calling this
         Initialize();
+        CpuGovernor::Boost boost(BOOST_WIFI_SETUP);
 
-        m_settings[F("WIFI")] = F("OFF");
-        m_settings.remove("wifi_configured");
+        m_settings.Set(SETTING_WIFI, WIFI_SETTING_OFF);
+        m_settings.Set(SETTING_WIFI_CONFIGURED, false);
 
-        m_settings.Save(true);
+        m_settings.Save();
 
-        m_wifiManager->resetSettings();
+        m_wifiManager.resetSettings();
         WiFi.persistent(true);
 
-        m_wifiManager->setConfigPortalTimeout(120);
+        m_wifiManager.setConfigPortalTimeout(120);
         m_display.DrawTextScrolling(F("Connect to Foxie_WiFiSetup"), GRAY);
         m_display.Clear();
         m_display.DrawText(1, F("<(I)>"), BLUE);
         m_display.Show();
 
-        if (m_wifiManager->autoConnect(String(F("Foxie_WiFiSetup")).c_str())) {
+        if (m_wifiManager.autoConnect(String(F("Foxie_WiFiSetup")).c_str())) {
             m_display.DrawTextScrolling(
-                F("Connected, adjust UTC offset for correct time."), GREEN);
-            m_settings[F("WIFI")] = F("ON");
-            m_settings[F("wifi_configured")] = F("1");
+                F("Connected, set TZ for correct time."), GREEN);
+            m_settings.Set(SETTING_WIFI, WIFI_SETTING_ON);
+            m_settings.Set(SETTING_WIFI_CONFIGURED, true);
         } else {
             m_display.DrawTextScrolling(F("FAILED"), RED);
-            m_settings[F("WIFI")] = F("OFF");
-            m_settings.remove("wifi_configured");
+            m_settings.Set(SETTING_WIFI, WIFI_SETTING_OFF);
+            m_settings.Set(SETTING_WIFI_CONFIGURED, false);
             WiFi.disconnect();
             m_isInitialized = false;
         }
-        m_settings.Save(true);
+        m_settings.Save();
     }
 
     void Initialize() {
         if (m_waitToInitialize.Ms() > WAIT_TO_INIT_MS && !m_isInitialized &&
-            m_settings[F("WIFI")] != F("OFF")) {
+            m_wifiSetting != WIFI_SETTING_OFF) {
             WiFi.begin();
             WiFi.persistent(true);
             m_isInitialized = true;
@@ -117,6 +143,7 @@ class FoxieWiFi {
 
     void InitializeOTA() {
         ArduinoOTA.onStart([&]() {
+            CpuGovernor::Set(BOOST_OTA, true);
             String type;
             if (ArduinoOTA.getCommand() == U_FS) {
                 LittleFS.end();
@@ -147,6 +174,7 @@ class FoxieWiFi {
             }
         });
         ArduinoOTA.onError([&](ota_error_t error) {
+            CpuGovernor::Set(BOOST_OTA, false);
             m_display.DrawTextScrolling(F("OTA ERR:") + String(error), RED);
         });
 
@@ -155,6 +183,15 @@ class FoxieWiFi {
         m_isOTAInitialized = true;
     }
 
+    // the report pages are only served in developer mode, like OTA. the
+    // server can't be stopped again, so it stays up until a reboot
+    void StartServer() {
+        if (!m_isServerStarted) {
+            m_server.begin();
+            m_isServerStarted = true;
+        }
+    }
+
     String GetUniqueMDNSName() {
         return F("FoxieClock_") + String(WiFi.localIP()[3], DEC);
     }
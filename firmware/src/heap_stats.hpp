@@ -0,0 +1,187 @@
+#pragma once
+#include <Arduino.h>  // for ESP, Print, String
+#include <stdint.h>   // for uint32_t and others
+
+#include "ring_buffer.hpp"
+
+/**
+ * Keeps track of the heap over the months a clock runs: the lowest free
+ * heap since boot, the largest free block and fragmentation, and an hourly
+ * history of those. Built with -D HEAP_STATS and the linker wrapping
+ * malloc() and friends (see platformio.ini), every allocation is also
+ * counted against the tag that's current when it's made: BOOT during
+ * setup(), the running task's tag while the Scheduler runs it, SYS for
+ * everything else (WiFi callbacks and the like).
+ *
+ * INFO shows the short GetSummary(). PrintReport() writes it all, the
+ * per-tag counts and the history too, for the serial port and /heap.
+ * */
+class HeapStats {
+  public:
+    enum Tag_e : uint8_t {
+        TAG_SYSTEM,
+        TAG_BOOT,
+        FIRST_TASK_TAG,
+    };
+
+    enum {
+        MAX_TAGS = 10,
+        HISTORY_SIZE = 24,
+        SAMPLE_INTERVAL_MS = 3600000,  // HISTORY_SIZE hours of history
+    };
+
+    struct Sample {
+        uint32_t uptimeMinutes;
+        uint32_t freeHeap;
+        uint16_t maxFreeBlock;
+        uint8_t fragmentation;  // percent
+    };
+
+    struct TagStats {
+        const char* name;
+        uint32_t allocations;
+        uint32_t bytes;
+    };
+
+  private:
+    inline static TagStats m_tags[MAX_TAGS] = {{"SYS"}, {"BOOT"}};
+    inline static uint8_t m_tagCount{FIRST_TASK_TAG};
+    inline static uint8_t m_tag{TAG_BOOT};
+
+    inline static uint32_t m_frees{0};
+    inline static uint32_t m_failures{0};
+    inline static uint32_t m_minFreeHeap{UINT32_MAX};
+
+    inline static Sample m_boot{};
+    inline static RingBuffer<Sample, HISTORY_SIZE> m_history;
+    inline static uint32_t m_lastSampleMs{0};
+
+  public:
+    // returns the new tag, or TAG_SYSTEM when they've all been handed out
+    static uint8_t AddTag(const char* name) {
+        if (m_tagCount == MAX_TAGS) {
+            return TAG_SYSTEM;
+        }
+        m_tags[m_tagCount].name = name;
+        return m_tagCount++;
+    }
+
+    // allocations from here on are counted against tag
+    static void SetTag(const uint8_t tag) { m_tag = tag; }
+
+    // at the end of setup(), keeps the heap as it is after boot
+    static void EndBoot() {
+        m_boot = TakeSample();
+        m_history.Push(m_boot);
+        m_lastSampleMs = millis();
+        m_tag = TAG_SYSTEM;
+    }
+
+    // called every second or so
+    static void Update() {
+        const Sample sample = TakeSample();
+        if (millis() - m_lastSampleMs >= SAMPLE_INTERVAL_MS) {
+            m_history.Push(sample);
+            m_lastSampleMs += SAMPLE_INTERVAL_MS;
+        }
+    }
+
+    // from the malloc() wrappers below
+    static void OnAllocation(const void* ptr, const size_t size) {
+        if (!ptr) {
+            m_failures++;
+            return;
+        }
+        m_tags[m_tag].allocations++;
+        m_tags[m_tag].bytes += size;
+        m_minFreeHeap = min(m_minFreeHeap, ESP.getFreeHeap());
+    }
+    static void OnFree(const void* ptr) {
+        if (ptr) {
+            m_frees++;
+        }
+    }
+
+    // "FH:<free>/<lowest> MFB:<largest block> FRAG:<percent>"
+    static String GetSummary() {
+        const Sample now = TakeSample();
+        return F("FH:") + String(now.freeHeap) + F("/") +
+               String(m_minFreeHeap) + F(" MFB:") + String(now.maxFreeBlock) +
+               F(" FRAG:") + String(now.fragmentation) + F("%");
+    }
+
+    // "ALLOC:<tag>:<count>/<bytes> ... FREE:<count>/<failed>"
+    static String GetAllocations() {
+        String allocations = F("ALLOC:");
+        for (size_t i = 0; i < m_tagCount; ++i) {
+            allocations += String(m_tags[i].name) + F(":") +
+                           String(m_tags[i].allocations) + F("/") +
+                           String(m_tags[i].bytes) + F("B ");
+        }
+        return allocations + F("FREE:") + String(m_frees) + F("/") +
+               String(m_failures);
+    }
+
+    static void PrintReport(Print& out) {
+        out.println(GetSummary() + F(" BOOT FH:") + String(m_boot.freeHeap) +
+                    F(" MFB:") + String(m_boot.maxFreeBlock));
+        out.println(GetAllocations());
+        for (size_t i = 0; i < m_history.Size(); ++i) {
+            const Sample& sample = m_history[i];
+            out.println(String(sample.uptimeMinutes) + F("MIN FH:") +
+                        String(sample.freeHeap) + F(" MFB:") +
+                        String(sample.maxFreeBlock) + F(" FRAG:") +
+                        String(sample.fragmentation) + F("%"));
+        }
+    }
+
+  private:
+    static Sample TakeSample() {
+        Sample sample;
+        sample.uptimeMinutes = millis() / 60000;
+        ESP.getHeapStats(&sample.freeHeap, &sample.maxFreeBlock,
+                         &sample.fragmentation);
+        m_minFreeHeap = min(m_minFreeHeap, sample.freeHeap);
+        return sample;
+    }
+};
+
+#ifdef HEAP_STATS
+// with -Wl,--wrap=malloc (and so on), every call to malloc() lands here
+// instead, and __real_malloc() is the original. these aren't meant for
+// allocations from interrupt handlers, which this firmware doesn't make
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+void* __wrap_malloc(size_t size) {
+    void* ptr = __real_malloc(size);
+    HeapStats::OnAllocation(ptr, size);
+    return ptr;
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    void* ptr = __real_calloc(count, size);
+    HeapStats::OnAllocation(ptr, count * size);
+    return ptr;
+}
+
+// Strings grow with realloc(), so each call is counted as an allocation
+void* __wrap_realloc(void* ptr, size_t size) {
+    void* newPtr = __real_realloc(ptr, size);
+    if (size) {
+        HeapStats::OnAllocation(newPtr, size);
+    } else {
+        HeapStats::OnFree(ptr);
+    }
+    return newPtr;
+}
+
+void __wrap_free(void* ptr) {
+    HeapStats::OnFree(ptr);
+    __real_free(ptr);
+}
+}
+#endif
@@ -0,0 +1,16 @@
+#pragma once
+#include <Arduino.h>  // for IRAM_ATTR
+
+// HOT_FUNC marks the functions the render and light sensor paths are
+// expected to spend their time in. the list is a guess from reading the
+// code, no profile has been taken yet; confirm it with tools/profile.py.
+// in the foxie-cardclock-hot env they're placed in IRAM, so that they
+// can't miss the instruction cache; everywhere else it does nothing.
+// tools/iram_headroom.py shows how much IRAM that leaves.
+//
+// a HOT_FUNC that the compiler inlines runs from wherever its caller is
+#ifdef HOT_FUNCS_IN_IRAM
+#define HOT_FUNC IRAM_ATTR
+#else
+#define HOT_FUNC
+#endif
@@ -0,0 +1,241 @@
+#pragma once
+#include <Arduino.h>  // for String
+#include <ESP8266WiFi.h>
+
+#include "elapsed_time.hpp"
+
+/**
+ * An HTTP GET for small text resources that doesn't hold up the main loop
+ * while it waits for the server. Begin() connects and sends the request;
+ * with a WiFiClientSecure, the TLS handshake happens here and is the one
+ * part that blocks. Update() then only reads whatever has arrived, and
+ * returns DONE once the server has closed the connection.
+ *
+ * Headers are looked at a line at a time as they arrive and only the
+ * status and Location are kept, so CDN headers of any size cost nothing.
+ * MAX_BODY_SIZE limits the body alone.
+ *
+ * The request is HTTP/1.0, so that the reply is never chunked and the
+ * server closes the connection after it. Redirects are left to the caller,
+ * see IsRedirect() and GetLocation().
+ * */
+class HttpGet {
+  public:
+    enum State_e {
+        IDLE,
+        READING,
+        DONE,
+        FAILED,
+    };
+
+    enum Error_e {
+        NO_ERROR,
+        BAD_URL,
+        CONNECTION_FAILED,
+        READ_TIMEOUT,
+        TOO_LARGE,
+        BAD_RESPONSE,
+    };
+
+  private:
+    enum {
+        HTTP_PORT = 80,
+        HTTPS_PORT = 443,
+        READ_TIMEOUT_MS = 5000,
+        MAX_LINE_SIZE = 256,  // the rest of a longer header line is dropped
+        MAX_BODY_SIZE = 1024,
+    };
+
+    WiFiClient* m_client{nullptr};
+    State_e m_state{IDLE};
+    Error_e m_error{NO_ERROR};
+    ElapsedTime m_sinceLastData;
+    String m_origin;  // scheme and host, for a relative Location
+    String m_line;    // the status or header line being read
+    bool m_isLineCut{false};
+    bool m_isInBody{false};
+    int m_status{0};
+    String m_location;
+    String m_body;
+
+  public:
+    // url is "http://host[:port]/path" or "https://..."
+    bool Begin(WiFiClient& client, const String& url) {
+        Stop();
+        m_client = &client;
+        m_line = "";
+        m_isLineCut = false;
+        m_isInBody = false;
+        m_status = 0;
+        m_location = "";
+        m_body = "";
+
+        String host;
+        String path;
+        uint16_t port;
+        if (!ParseUrl(url, m_origin, host, port, path)) {
+            return Fail(BAD_URL);
+        }
+        if (!m_client->connect(host.c_str(), port)) {
+            return Fail(CONNECTION_FAILED);
+        }
+
+        m_client->print(F("GET ") + path + F(" HTTP/1.0\r\nHost: ") + host +
+                        F("\r\nUser-Agent: CardClock\r\n\r\n"));
+        m_sinceLastData.Reset();
+        m_state = READING;
+        m_error = NO_ERROR;
+        return true;
+    }
+
+    State_e Update() {
+        if (m_state != READING) {
+            return m_state;
+        }
+
+        bool gotData = false;
+        while (m_client->available()) {
+            const int c = m_client->read();
+            if (c < 0) {
+                break;
+            }
+            gotData = true;
+            if (!m_isInBody) {
+                if (!ReadHeaderChar(c)) {
+                    return m_state;
+                }
+            } else if (m_body.length() == MAX_BODY_SIZE) {
+                Fail(TOO_LARGE);
+                return m_state;
+            } else {
+                m_body += (char)c;
+            }
+        }
+
+        if (gotData) {
+            m_sinceLastData.Reset();
+        } else if (!m_client->connected()) {
+            m_client->stop();
+            if (m_isInBody) {
+                m_state = DONE;
+            } else {
+                Fail(BAD_RESPONSE);  // closed before the headers ended
+            }
+        } else if (m_sinceLastData.Ms() > READ_TIMEOUT_MS) {
+            Fail(READ_TIMEOUT);
+        }
+        return m_state;
+    }
+
+    void Stop() {
+        if (m_client && m_state == READING) {
+            m_client->stop();
+        }
+        m_state = IDLE;
+    }
+
+    State_e GetState() { return m_state; }
+    Error_e GetError() { return m_error; }
+    String GetErrorString() {
+        switch (m_error) {
+            case NO_ERROR:
+                return F("No error");
+            case BAD_URL:
+                return F("Bad URL");
+            case CONNECTION_FAILED:
+                return F("Connection failed");
+            case READ_TIMEOUT:
+                return F("Read timeout");
+            case TOO_LARGE:
+                return F("Response too large");
+            case BAD_RESPONSE:
+                break;
+        }
+        return F("Bad response");
+    }
+    int GetStatus() { return m_status; }
+    const String& GetBody() { return m_body; }
+    const String& GetLocation() { return m_location; }
+    bool IsRedirect() {
+        return m_status >= 300 && m_status < 400 && !m_location.isEmpty();
+    }
+
+  private:
+    bool Fail(const Error_e error) {
+        Stop();
+        m_error = error;
+        m_state = FAILED;
+        return false;
+    }
+
+    static bool ParseUrl(const String& url,
+                         String& origin,
+                         String& host,
+                         uint16_t& port,
+                         String& path) {
+        int start;
+        if (url.startsWith(F("https://"))) {
+            start = 8;
+            port = HTTPS_PORT;
+        } else if (url.startsWith(F("http://"))) {
+            start = 7;
+            port = HTTP_PORT;
+        } else {
+            return false;
+        }
+
+        int pathStart = url.indexOf('/', start);
+        if (pathStart < 0) {
+            pathStart = url.length();
+        }
+        origin = url.substring(0, pathStart);
+        host = url.substring(start, pathStart);
+        path = pathStart < (int)url.length() ? url.substring(pathStart) : "/";
+
+        const int colon = host.indexOf(':');
+        if (colon >= 0) {
+            port = host.substring(colon + 1).toInt();
+            host = host.substring(0, colon);
+        }
+        return !host.isEmpty() && port;
+    }
+
+    // "HTTP/1.x <status> ...", then headers up to an empty line. false once
+    // the response has failed
+    bool ReadHeaderChar(const char c) {
+        if (c == '\r') {
+            return true;
+        }
+        if (c != '\n') {
+            if (m_line.length() < MAX_LINE_SIZE) {
+                m_line += c;
+            } else {
+                m_isLineCut = true;
+            }
+            return true;
+        }
+
+        if (!m_status) {
+            m_status = m_line.startsWith(F("HTTP/1."))
+                           ? m_line.substring(m_line.indexOf(' ') + 1).toInt()
+                           : 0;
+            if (m_status <= 0) {
+                return Fail(BAD_RESPONSE);
+            }
+        } else if (m_line.isEmpty()) {
+            m_isInBody = true;
+        } else if (m_line.substring(0, 9).equalsIgnoreCase(F("Location:"))) {
+            if (m_isLineCut) {
+                return Fail(TOO_LARGE);
+            }
+            m_location = m_line.substring(9);
+            m_location.trim();
+            if (m_location.startsWith(F("/"))) {
+                m_location = m_origin + m_location;
+            }
+        }
+        m_line = "";
+        m_isLineCut = false;
+        return true;
+    }
+};
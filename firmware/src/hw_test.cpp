@@ -64,8 +64,8 @@ void setup() {
         if (evt == Button::PRESS) {
             g_results.left = true;
 
-            Rtc_Pcf8563 tempRtc;
-            tempRtc.setTime(13, 37, 42);
+            Pcf8563 tempRtc;
+            tempRtc.WriteTime(13, 37, 42);
         }
     };
 
@@ -0,0 +1,93 @@
+#pragma once
+#include <Arduino.h>  // for micros()
+#include <Wire.h>
+#include <stdint.h>  // for uint8_t and others
+
+#include "cpu_governor.hpp"
+
+/**
+ * Register-oriented access to the I2C bus. Every Read()/Write() is exactly one
+ * bus transaction, no matter how many registers it covers, and the time
+ * spent on the bus is accounted for so we can see what the RTC costs us.
+ * */
+class I2CBus {
+  public:
+    enum {
+        FAST_MODE_HZ = 400000,  // the PCF8563 is rated for fast-mode
+    };
+
+    struct Stats {
+        uint32_t transactions;
+        uint32_t bytes;  // register address + data bytes
+        uint32_t busMicros;
+        uint32_t errors;
+    };
+
+  private:
+    inline static Stats m_stats{};
+    inline static bool m_isInitialized{false};
+
+  public:
+    static void Initialize() {
+        if (!m_isInitialized) {
+            Wire.begin();
+            Wire.setClock(FAST_MODE_HZ);
+            m_isInitialized = true;
+        }
+    }
+
+    // reads len consecutive registers starting at reg, using a repeated start
+    // so that the address write and the data read are one transaction
+    static bool Read(const uint8_t address,
+                     const uint8_t reg,
+                     uint8_t* data,
+                     const size_t len) {
+        CpuGovernor::BaseFrequency baseFrequency;  // SCL is timed at F_CPU
+        const uint32_t start = micros();
+        bool success = false;
+
+        Wire.beginTransmission(address);
+        Wire.write(reg);
+        if (Wire.endTransmission(false) == 0 &&
+            Wire.requestFrom(address, len) == len) {
+            for (size_t i = 0; i < len; ++i) {
+                data[i] = Wire.read();
+            }
+            success = true;
+        }
+
+        Account(start, len + 1, success);
+        return success;
+    }
+
+    static bool Write(const uint8_t address,
+                      const uint8_t reg,
+                      const uint8_t* data,
+                      const size_t len) {
+        CpuGovernor::BaseFrequency baseFrequency;  // SCL is timed at F_CPU
+        const uint32_t start = micros();
+
+        Wire.beginTransmission(address);
+        Wire.write(reg);
+        Wire.write(data, len);
+        const bool success = Wire.endTransmission() == 0;
+
+        Account(start, len + 1, success);
+        return success;
+    }
+
+    static const Stats& GetStats() { return m_stats; }
+    static void ResetStats() { m_stats = Stats{}; }
+
+  private:
+    static void Account(const uint32_t start,
+                        const size_t bytes,
+                        const bool success) {
+        m_stats.transactions++;
+        m_stats.bytes += bytes;
+        m_stats.busMicros += micros() - start;
+        if (!success) {
+            m_stats.errors++;
+        }
+    }
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include <Arduino.h>  // for micros(), IRAM_ATTR
+#include <stdint.h>   // for uint8_t and others
+
+#include "isr_queue.hpp"
+
+struct IsrEvent {
+    uint8_t type;
+    uint8_t pin;
+    uint8_t level;
+    uint32_t micros;  // captured in the ISR
+};
+
+/**
+ * The one queue all GPIO interrupt handlers push into. The ESP8266 services
+ * every GPIO interrupt from the same (non-nesting) handler, so all of them
+ * together form a single producer; the main loop is the only consumer.
+ *
+ * Edges that happen while interrupts are disabled (e.g. during
+ * Display::Show) stay latched in the GPIO status register and are pushed as
+ * soon as interrupts are enabled again. Repeated edges on one pin during
+ * such a window collapse into one event, but since the handler samples the
+ * pin level, the last event always reflects the actual state of the pin.
+ * */
+class IsrEvents {
+  public:
+    enum Type_e {
+        RTC_TICK,
+        BUTTON_EDGE,
+    };
+
+  private:
+    enum {
+        QUEUE_SIZE = 64,
+    };
+
+    inline static IsrQueue<IsrEvent, QUEUE_SIZE> m_queue;
+
+  public:
+    static inline void IRAM_ATTR Push(const Type_e type,
+                                      const uint8_t pin = 0,
+                                      const uint8_t level = 0) {
+        m_queue.Push({(uint8_t)type, pin, level, (uint32_t)micros()});
+    }
+
+    static bool Pop(IsrEvent& evt) { return m_queue.Pop(evt); }
+    static bool IsEmpty() { return m_queue.IsEmpty(); }
+
+    // number of events lost because the main loop fell behind. consumers
+    // that track state through events should resync when this changes.
+    static uint32_t GetDropped() { return m_queue.GetDropped(); }
+
+    // converts an event timestamp to the millis() timebase
+    static unsigned long ToMillis(const IsrEvent& evt) {
+        return millis() - ((uint32_t)micros() - evt.micros) / 1000;
+    }
+};
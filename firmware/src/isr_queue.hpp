@@ -0,0 +1,63 @@
+#pragma once
+#include <Arduino.h>  // for IRAM_ATTR
+#include <stdint.h>   // for uint32_t
+
+/**
+ * Lock-free single-producer/single-consumer ring buffer used to hand events
+ * from interrupt handlers to the main loop. The producer only ever writes
+ * m_head and the consumer only ever writes m_tail, so neither side needs to
+ * disable interrupts. The ESP8266 has a single core, so a compiler barrier
+ * between filling a slot and publishing the index is all the ordering that
+ * is required.
+ *
+ * If the consumer falls behind, new items are dropped (never overwritten)
+ * and counted so that the consumer can resynchronize.
+ * */
+template <typename T, uint32_t SIZE>
+class IsrQueue {
+    static_assert(SIZE && (SIZE & (SIZE - 1)) == 0,
+                  "SIZE must be a power of two");
+
+  private:
+    T m_items[SIZE];
+    volatile uint32_t m_head{0};  // written by the producer only
+    volatile uint32_t m_tail{0};  // written by the consumer only
+    volatile uint32_t m_dropped{0};
+
+  public:
+    // producer side, safe to call from an ISR
+    bool IRAM_ATTR Push(const T& item) {
+        const uint32_t head = m_head;
+        if (head - m_tail == SIZE) {
+            m_dropped = m_dropped + 1;
+            return false;
+        }
+
+        m_items[head & (SIZE - 1)] = item;
+        Barrier();
+        m_head = head + 1;
+        return true;
+    }
+
+    // consumer side, main loop only
+    bool Pop(T& item) {
+        const uint32_t tail = m_tail;
+        if (tail == m_head) {
+            return false;
+        }
+
+        item = m_items[tail & (SIZE - 1)];
+        Barrier();
+        m_tail = tail + 1;
+        return true;
+    }
+
+    bool IsEmpty() const { return m_tail == m_head; }
+    uint32_t Size() const { return m_head - m_tail; }
+    uint32_t GetDropped() const { return m_dropped; }
+
+  private:
+    static inline void IRAM_ATTR Barrier() {
+        __asm__ __volatile__("" ::: "memory");
+    }
+};
@@ -3,7 +3,9 @@
 #include <stdint.h>          // for uint16_t and others
 #include <user_interface.h>  // for ESP-specific API calls
 
+#include "critical_section.hpp"
 #include "elapsed_time.hpp"
+#include "hot_func.hpp"
 
 /**
  * This class solves two problems:
@@ -45,7 +47,7 @@ class LightSensor {
         m_curBrightness = GetHistoryMean();
     }
 
-    size_t Get() {
+    HOT_FUNC size_t Get() {
         m_history[m_historyPos] = GetCurrentADCValue();
         if (m_historyPos++ == HISTORY_SIZE) {
             m_historyPos = 0;
@@ -74,7 +76,7 @@ class LightSensor {
     }
 
   private:
-    size_t GetHistoryMean() {
+    HOT_FUNC size_t GetHistoryMean() {
         size_t mean = 0;
         for (size_t i = 0; i < HISTORY_SIZE; i++) {
             mean += m_history[i];
@@ -84,16 +86,11 @@ class LightSensor {
     }
 
     // get a smoothed, bounded value from the sensor
-    size_t GetCurrentADCValue() {
-        system_soft_wdt_stop();
-        ets_intr_lock();
-        noInterrupts();
-
-        system_adc_read_fast(m_samples, ADC_SAMPLES, ADC_CLOCK_DIVIDER);
-
-        interrupts();
-        ets_intr_unlock();
-        system_soft_wdt_restart();
+    HOT_FUNC size_t GetCurrentADCValue() {
+        {
+            CriticalSection critical(CRITICAL_ADC_READ);
+            system_adc_read_fast(m_samples, ADC_SAMPLES, ADC_CLOCK_DIVIDER);
+        }
 
         size_t mean = 0;
         for (size_t i = 0; i < ADC_SAMPLES; i++) {
@@ -0,0 +1,160 @@
+#pragma once
+#include <Arduino.h>  // for ESP, Print, String
+#include <stdint.h>   // for uint32_t and others
+
+#include "cpu_governor.hpp"
+#include "ring_buffer.hpp"
+
+/**
+ * Times each stage of a loop iteration with the CPU's cycle counter, so a
+ * stutter can be pinned on the stage that caused it. Every stage keeps a
+ * histogram of its run times in power-of-two buckets of microseconds and
+ * its maximum; iterations that take longer than SLOW_LOOP_US are counted
+ * and the last few logged, with the stage that took the longest in them.
+ *
+ * Everything is fixed size, about 700 bytes for MAX_STAGES stages. The
+ * tracer times its own bookkeeping too, which PrintReport() shows as a
+ * share of the run time. Times come from CpuGovernor::NowUs(), so they
+ * stay right across speed switches and cycle counter wraps.
+ * */
+class LoopTracer {
+  public:
+    enum {
+        MAX_STAGES = 8,
+        BUCKETS = 20,          // <1us, <2us, <4us ... >=262ms
+        SLOW_LOOP_US = 20000,  // long enough to hold up a frame
+        SLOW_LOG_SIZE = 8,
+        NO_STAGE = 0xff,
+    };
+
+    struct SlowLoop {
+        uint32_t atMs;
+        uint32_t us;
+        uint8_t slowestStage;
+        uint32_t slowestUs;
+    };
+
+  private:
+    struct Stage {
+        const char* name;
+        uint32_t runs;
+        uint32_t maxUs;
+        uint32_t histogram[BUCKETS];
+    };
+
+    Stage m_stages[MAX_STAGES]{};
+    size_t m_stageCount{0};
+
+    uint32_t m_loopStartCycles{0};
+    uint32_t m_loopStartUs{0};
+    uint32_t m_stageStartUs{0};
+    uint8_t m_slowestStage{NO_STAGE};
+    uint32_t m_slowestUs{0};
+
+    uint32_t m_loops{0};
+    uint32_t m_maxLoopUs{0};
+    uint32_t m_slowLoops{0};
+    RingBuffer<SlowLoop, SLOW_LOG_SIZE> m_slowLog;
+
+    uint64_t m_overheadCycles{0};
+    uint64_t m_loopCycles{0};
+
+  public:
+    // returns the stage's id, or NO_STAGE when full
+    uint8_t AddStage(const char* name) {
+        if (m_stageCount == MAX_STAGES) {
+            return NO_STAGE;
+        }
+        m_stages[m_stageCount].name = name;
+        return m_stageCount++;
+    }
+
+    void BeginLoop() {
+        m_loopStartCycles = ESP.getCycleCount();
+        m_loopStartUs = CpuGovernor::NowUs();
+        m_slowestStage = NO_STAGE;
+        m_slowestUs = 0;
+    }
+
+    void BeginStage() { m_stageStartUs = CpuGovernor::NowUs(); }
+
+    // returns how long the stage took, in microseconds
+    uint32_t EndStage(const uint8_t stage) {
+        const uint32_t end = ESP.getCycleCount();
+        const uint32_t us = CpuGovernor::NowUs() - m_stageStartUs;
+        if (stage < m_stageCount) {
+            Stage& s = m_stages[stage];
+            s.runs++;
+            s.maxUs = max(s.maxUs, us);
+            s.histogram[GetBucket(us)]++;
+            if (us >= m_slowestUs) {
+                m_slowestStage = stage;
+                m_slowestUs = us;
+            }
+        }
+        m_overheadCycles += ESP.getCycleCount() - end;
+        return us;
+    }
+
+    void EndLoop() {
+        const uint32_t end = ESP.getCycleCount();
+        const uint32_t cycles = end - m_loopStartCycles;
+        const uint32_t us = CpuGovernor::NowUs() - m_loopStartUs;
+        m_loops++;
+        m_loopCycles += cycles;
+        m_maxLoopUs = max(m_maxLoopUs, us);
+        if (us > SLOW_LOOP_US) {
+            m_slowLoops++;
+            m_slowLog.Push({(uint32_t)millis(), us, m_slowestStage,
+                            m_slowestUs});
+        }
+        m_overheadCycles += ESP.getCycleCount() - end;
+    }
+
+    // the whole lot, one line per stage and per logged slow loop
+    void PrintReport(Print& out) {
+        out.println(F("LOOPS:") + String(m_loops) + F(" MAX:") +
+                    String(m_maxLoopUs) + F("US SLOW:") + String(m_slowLoops) +
+                    F(" (>") + String(SLOW_LOOP_US) + F("US) TRACING:") +
+                    String(GetOverheadPermille()) + F("/1000 OF BUSY TIME"));
+
+        for (size_t i = 0; i < m_stageCount; ++i) {
+            const Stage& s = m_stages[i];
+            String line = String(s.name) + F(" RUNS:") + String(s.runs) +
+                          F(" MAX:") + String(s.maxUs) + F("US");
+            for (size_t bucket = 0; bucket < BUCKETS; ++bucket) {
+                if (!s.histogram[bucket]) {
+                    continue;
+                }
+                if (bucket < BUCKETS - 1) {
+                    line += F(" <") + String(1UL << bucket);
+                } else {
+                    line += F(" >=") + String(1UL << (bucket - 1));
+                }
+                line += F(":") + String(s.histogram[bucket]);
+            }
+            out.println(line);
+        }
+
+        for (size_t i = 0; i < m_slowLog.Size(); ++i) {
+            const SlowLoop& slow = m_slowLog[i];
+            const char* name = slow.slowestStage < m_stageCount
+                                   ? m_stages[slow.slowestStage].name
+                                   : "-";
+            out.println(F("SLOW AT ") + String(slow.atMs) + F("MS: ") +
+                        String(slow.us) + F("US, ") + String(name) + F(" ") +
+                        String(slow.slowestUs) + F("US"));
+        }
+    }
+
+  private:
+    // bucket n holds times under 2^n microseconds, the last one the rest
+    static size_t GetBucket(const uint32_t us) {
+        const size_t bucket = us ? 32 - __builtin_clz(us) : 0;
+        return bucket < BUCKETS ? bucket : BUCKETS - 1;
+    }
+
+    uint32_t GetOverheadPermille() {
+        return m_loopCycles ? m_overheadCycles * 1000 / m_loopCycles : 0;
+    }
+};
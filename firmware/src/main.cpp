@@ -2,85 +2,181 @@
 #include <ESP8266WiFi.h>
 #include <LittleFS.h>
 #include <user_interface.h>  // for ESP-specific API calls
-#include <memory>            // for std::shared_ptr
 
 // you might be asking yourself -- why is all the code in header files?
 // answer: in a relatively small project like this, the separation of .hpp/.cpp
 // files adds an unnecessarily cumbersome layer to rapid iteration
 
+#include "boot_timeline.hpp"
 #include "clock.hpp"
 #include "config_menu.hpp"
+#include "cpu_governor.hpp"
+#include "critical_section.hpp"
 #include "display.hpp"
 #include "foxie_ntp.hpp"
 #include "foxie_wifi.hpp"
+#include "heap_stats.hpp"
 #include "option.hpp"
+#include "scheduler.hpp"
 #include "settings.hpp"
 #include "time_menu.hpp"
 #include "web_update.hpp"
 
-void CheckButtonsOnBoot(Settings& settings, Display& display, FoxieWiFi& wifi);
+#ifdef SAMPLING_PROFILER
+#include "sampling_profiler.hpp"
+#endif
+
+void CheckButtonsOnBoot(Settings& settings, Display& display);
+void HandleSerialCommands(Scheduler& scheduler, Display& display);
+void PrintTraceReport(Print& out, Scheduler& scheduler, Display& display);
 
 void setup() {
-    using namespace std;
-    auto settings = make_shared<Settings>();
-    auto display = make_shared<Display>(*settings);
-    auto wifi = make_shared<FoxieWiFi>(*settings, *display);
-    auto updater = make_shared<WebUpdate>(*settings, *display);
-
-    CheckButtonsOnBoot(*settings, *display, *wifi);
-
-    auto rtc = make_shared<Rtc>(*settings);
-    auto ntp = make_shared<FoxieNTP>(*settings, *rtc);
-    auto menuMgr = make_shared<MenuManager>(*display, *settings);
-
-    menuMgr->Add(make_shared<TimeMenu>(*display, *rtc, *settings));  // menu 0
-    menuMgr->Add(make_shared<Clock>(*display, *rtc, *settings));     // menu 1
-
-    // all config menu options are below
-    auto configMenu = make_shared<ConfigMenu>(*display, *settings);  // menu 2
-    configMenu->AddRangeSetting(F("MINB"), MIN_BRIGHTNESS, MAX_BRIGHTNESS);
-    configMenu->AddRangeSetting(F("MAXB"), MIN_BRIGHTNESS, MAX_BRIGHTNESS);
-    configMenu->AddTextSetting(F("CLKB"), {F("OFF"), F("ON")});
-    configMenu->AddTextSetting(F("WLED"), {F("OFF"), F("ON")});
-    configMenu->AddTextSetting(F("24HR"), {"OFF", "ON"});
-    configMenu->AddRangeSetting(F("UTC"), -12, 12,
-                                [&]() { ntp->UpdateRTCTime(); });
-    configMenu->AddTextSetting(F("WIFI"), {"OFF", "ON", "CFG"});
-    configMenu->AddRunFuncSetting(F("INFO"), [&]() {
+    BootTimeline::Start();
+    Serial.begin(115200);  // see HandleSerialCommands()
+
+    // a frame takes ~3.3ms with interrupts off, anything much longer than
+    // that is worth hearing about
+    enum {
+        CRITICAL_ALERT_US = 5000,
+    };
+    CriticalSection::SetAlert(
+        CRITICAL_ALERT_US, [](CriticalSite_e site, uint32_t us) {
+            Serial.println(F("INTERRUPTS OFF IN ") +
+                           String(CriticalSection::GetName(site)) + F(" FOR ") +
+                           String(us) + F("US"));
+        });
+
+    // every subsystem lives in static storage rather than on the heap, so
+    // the heap only holds what comes and goes (Strings, WiFi, TLS).
+    // what it takes to show the time comes first, the rest after the first
+    // frame. see BootTimeline::PrintReport() for how long each part takes
+    static Settings settings;
+    BootTimeline::Mark(BOOT_SETTINGS);
+    static Display display(settings);
+    BootTimeline::Mark(BOOT_DISPLAY);
+
+    CheckButtonsOnBoot(settings, display);
+
+    static Rtc rtc(settings);
+    static MenuManager menuMgr(display, settings);
+    static TimeMenu timeMenu(display, rtc, settings);
+    static Clock clockMenu(display, rtc, settings);
+    menuMgr.Add(timeMenu);   // menu 0
+    menuMgr.Add(clockMenu);  // menu 1
+    menuMgr.SetDefaultAndActivateMenu(1);  // clock menu
+
+    rtc.Update();  // brings the RTC up and reads the time
+    menuMgr.Update();
+    display.Update(true);
+    BootTimeline::Mark(BOOT_FIRST_FRAME);
+
+    static FoxieWiFi wifi(settings, display);
+    BootTimeline::Mark(BOOT_WIFI);
+    static WebUpdate updater(settings, display);
+    BootTimeline::Mark(BOOT_UPDATE);
+    static FoxieNTP ntp(settings, rtc);
+    static Scheduler scheduler;
+
+    // the config menu's entries are in menu_tree.hpp
+    static ConfigMenu configMenu(display, settings, updater);  // menu 2
+    configMenu.SetAction(ACTION_INFO, [&]() {
         String info;
         info += F("IP:");
         info +=
             WiFi.isConnected() ? WiFi.localIP().toString() : F("NOT CONNECTED");
-        info += F(" FH:") + String(ESP.getFreeHeap());
+        info += F(" ") + HeapStats::GetSummary();
         info += F(" FCS:") + String(ESP.getFreeContStack());
         info += F(" UPT:") + String(millis() / 1000 / 60);
+        info += F(" BOOT:") + BootTimeline::GetSummary();
+        info += F(" RTC:") + String(rtc.GetInitMicros()) + F("US");
+        info += F(" I2C:") + String(I2CBus::GetStats().transactions) + F("/") +
+                String(I2CBus::GetStats().busMicros) + F("US");
+        info += F(" BTN:") + String(menuMgr.GetButtonStageAvgUs()) + F("/") +
+                String(menuMgr.GetButtonStageMaxUs()) + F("US");
+        info += F(" LAT:") + String(Button::GetAvgLatencyUs()) + F("/") +
+                String(Button::GetMaxLatencyUs()) + F("US");
+        info += F(" DRW:") + String(menuMgr.GetRedraws()) + F("/") +
+                String(menuMgr.GetUpdates());
+        info += F(" IDLE:") + String(scheduler.GetIdlePercent()) + F("%");
+        info += F(" UPD:") + String(updater.GetLastCheckMs()) + F("MS");
+        info += F(" SET:") + String(settings.GetLoadMicros()) + F("US/") +
+                String(settings.GetSource());
+        info += F(" FLW:") + String(settings.GetFlashBytesWritten()) +
+                F("B/") + String(settings.GetCompactions());
+        if (ntp.IsSynced()) {
+            info += F(" NTP:") + String(ntp.GetLastOffsetMs()) + F("MS/") +
+                    String(ntp.GetLastDelayMs()) + F("MS");
+            info += F(" POLL:") +
+                    String(ntp.GetPollScheduler().GetIntervalMs() / 1000) +
+                    F("S DRIFT:") +
+                    String(ntp.GetPollScheduler().GetDriftPpm()) + F("PPM");
+            info += F(" SRV:") + String(ntp.GetSelector().GetSurvivors()) +
+                    F("/") + String(ntp.GetSelector().GetCount());
+        }
 
-        display->DrawTextScrolling(info, GREEN);
+        display.DrawTextScrolling(info, GREEN);
     });
-    configMenu->AddRunFuncSetting(F("VER"), [&]() {
-        display->DrawTextScrolling(F("FC/OS v") + String(FW_VERSION) +
+    configMenu.SetAction(ACTION_VERSION, [&]() {
+        display.DrawTextScrolling(F("FC/OS v") + String(FW_VERSION) +
                                        F(" and may the schwartz be with you!"),
                                    PURPLE);
     });
-    configMenu->AddTextSetting(F("DEVL"), {F("OFF"), F("ON")});
-    configMenu->AddRunFuncSetting(F("UPDT"), [&]() { updater->Download(); });
-    menuMgr->Add(configMenu);
-
-    menuMgr->SetDefaultAndActivateMenu(1);  // clock menu
+    menuMgr.Add(configMenu);
+
+    // how often each task runs, unless an interrupt makes it due sooner
+    enum {
+        RTC_PERIOD_MS = 100,  // in case the RTC stops sending its ticks
+        NTP_PERIOD_MS = 10,   // the RTC is set within 20ms of a second
+        MENU_PERIOD_MS = 10,  // button repeats and animations
+        WIFI_PERIOD_MS = 20,
+        DISPLAY_PERIOD_MS = 3,  // light sensor every 3ms, frames every 33ms
+        HEAP_PERIOD_MS = 1000,
+        SERIAL_PERIOD_MS = 100,
+    };
+    const int rtcTask =
+        scheduler.Add("RTC", RTC_PERIOD_MS, [&]() { rtc.Update(); });
+    scheduler.Add("NTP", NTP_PERIOD_MS, [&]() { ntp.Update(); });
+    const int menuTask =
+        scheduler.Add("MENU", MENU_PERIOD_MS, [&]() { menuMgr.Update(); });
+    scheduler.Add("WIFI", WIFI_PERIOD_MS, [&]() { wifi.Update(); });
+    scheduler.Add("DISP", DISPLAY_PERIOD_MS, [&]() { display.Update(); });
+    scheduler.Add("HEAP", HEAP_PERIOD_MS, []() { HeapStats::Update(); });
+    scheduler.Add("SER", SERIAL_PERIOD_MS,
+                  [&]() { HandleSerialCommands(scheduler, display); });
+
+    wifi.AddReportPage("/heap",
+                       [](Print& out) { HeapStats::PrintReport(out); });
+    wifi.AddReportPage("/trace", [&](Print& out) {
+        PrintTraceReport(out, scheduler, display);
+    });
+    wifi.AddReportPage("/boot",
+                       [](Print& out) { BootTimeline::PrintReport(out); });
+    BootTimeline::Mark(BOOT_MENUS);
 
     // use a while loop instead of loop() ... I just hate globals, OK?
+    HeapStats::EndBoot();
+#ifdef SAMPLING_PROFILER
+    SamplingProfiler::Start();
+#endif
+
     while (true) {
-        rtc->Update();
-        ntp->Update();
-        menuMgr->Update();
-        wifi->Update();
-        display->Update();
+        // GPIO interrupts only queue events, they are handled here
+        IsrEvent evt;
+        while (IsrEvents::Pop(evt)) {
+            rtc.HandleEvent(evt);
+            menuMgr.HandleEvent(evt);
+            if (evt.type == IsrEvents::RTC_TICK) {
+                scheduler.RunNow(rtcTask);
+            }
+            scheduler.RunNow(menuTask);  // a new second or a button
+        }
 
-        yield();  // allow the ESP's system/WiFi code a chance to run
+        scheduler.RunDueTasks();
+        scheduler.Sleep();
     }
 }
 
-void CheckButtonsOnBoot(Settings& settings, Display& display, FoxieWiFi& wifi) {
+void CheckButtonsOnBoot(Settings& settings, Display& display) {
     pinMode(PIN_BTN_UP, INPUT_PULLUP);
     pinMode(PIN_BTN_DOWN, INPUT);
     pinMode(PIN_BTN_LEFT, INPUT_PULLUP);
@@ -91,8 +187,10 @@ void CheckButtonsOnBoot(Settings& settings, Display& display, FoxieWiFi& wifi) {
     // just in case you accidentally put the board into a reboot loop that
     // doesn't involve any of the code this "safe" mode depends on...
     if (Button::AreAnyButtonsPressed() == PIN_BTN_LEFT) {
+        // only ever built here, setup() builds its own after the first frame
+        static FoxieWiFi wifi(settings, display);
         display.DrawTextCentered(F("SAFE"), ORANGE);
-        settings[F("DEVL")] == F("ON");
+        settings.Set(SETTING_DEVL, true);
         while (true) {
             wifi.Update();
             display.Update();
@@ -110,15 +208,48 @@ void CheckButtonsOnBoot(Settings& settings, Display& display, FoxieWiFi& wifi) {
 
         if (Button::WaitForButtonPress() == PIN_BTN_RIGHT) {
             display.DrawTextScrolling(F("SETTINGS CLEARED"), PURPLE);
-            settings.clear();
-            settings.Save();
+            settings.Erase();
             ESP.eraseConfig();
-            Rtc_Pcf8563 rtc;
-            rtc.zeroClock();
+            Pcf8563 rtc;
+            rtc.ZeroClock();
             Button::WaitForNoButtons();
             ESP.restart();
         }
     }
 }
 
+// one letter commands on the serial port, for the reports that are also
+// at http://<clock>/heap, /trace and /boot in developer mode
+void HandleSerialCommands(Scheduler& scheduler, Display& display) {
+#ifdef SAMPLING_PROFILER
+    SamplingProfiler::Update(Serial);
+#endif
+
+    while (Serial.available()) {
+        switch (Serial.read()) {
+            case 'h':
+                HeapStats::PrintReport(Serial);
+                break;
+            case 't':
+                PrintTraceReport(Serial, scheduler, display);
+                break;
+            case 'b':
+                BootTimeline::PrintReport(Serial);
+                break;
+        }
+    }
+}
+
+// where the time goes: the tasks and loops, interrupts-off time, the CPU
+// speed and how evenly frames are shown
+void PrintTraceReport(Print& out, Scheduler& scheduler, Display& display) {
+    scheduler.PrintReport(out);
+    CriticalSection::PrintReport(out);
+    CpuGovernor::PrintReport(out);
+    const Display::FrameStats& frames = display.GetFrameStats();
+    out.println(F("FRAMES AVG:") + String(frames.avgUs) + F("US MIN:") +
+                String(frames.minUs) + F("US MAX:") + String(frames.maxUs) +
+                F("US"));
+}
+
 void loop() {}
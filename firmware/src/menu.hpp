@@ -1,19 +1,36 @@
 #pragma once
 #include <Arduino.h>
-#include <memory>  // for std::shared_ptr
-#include <vector>  // for std::vector
 
 #include "button.hpp"
 #include "display.hpp"
 #include "elapsed_time.hpp"
 #include "settings.hpp"
 
+/**
+ * A screen of the clock. Update() draws it, and is only called when the
+ * menu needs a redraw: after a button event or activation, when a deadline
+ * set with RedrawIn() passes, or continuously at the rate given to
+ * SetRedrawPeriod() for animations. A menu that sets neither is static,
+ * and costs nothing between button presses apart from an occasional
+ * redraw in case something else drew over it.
+ * */
 class Menu {
+  public:
+    enum {
+        MAX_REDRAW_INTERVAL_MS = 1000,
+    };
+
   protected:
     Display& m_display;
     Settings& m_settings;
     ElapsedTime m_timeSinceButtonPress;
 
+  private:
+    bool m_needsRedraw{true};
+    size_t m_redrawPeriodMs{0};
+    size_t m_redrawInMs{MAX_REDRAW_INTERVAL_MS};
+    ElapsedTime m_sinceRedraw;
+
   public:
     Menu(Display& display, Settings& settings)
         : m_display(display), m_settings(settings) {}
@@ -21,6 +38,28 @@ class Menu {
     void ResetTimeSinceButtonPress() { m_timeSinceButtonPress.Reset(); }
     size_t GetTimeSinceButtonPress() { return m_timeSinceButtonPress.Ms(); }
 
+    void Invalidate() { m_needsRedraw = true; }
+    bool IsRedrawDue() {
+        const size_t sinceRedraw = m_sinceRedraw.Ms();
+        return m_needsRedraw || sinceRedraw >= m_redrawInMs ||
+               (m_redrawPeriodMs && sinceRedraw >= m_redrawPeriodMs);
+    }
+
+    void Redraw() {
+        m_needsRedraw = false;
+        m_redrawInMs = MAX_REDRAW_INTERVAL_MS;
+        m_sinceRedraw.Reset();
+        Update();
+    }
+
+  protected:
+    // for animations, 0 to stop
+    void SetRedrawPeriod(const size_t ms) { m_redrawPeriodMs = ms; }
+
+    // from Update(), for a screen that changes at a known time
+    void RedrawIn(const size_t ms) { m_redrawInMs = min(m_redrawInMs, ms); }
+
+  public:
     virtual void Update() = 0;
     virtual void Activate() {}  // called when menu becomes active
     virtual void Hide() {}      // called when menu becomes inactive
@@ -36,14 +75,24 @@ class MenuManager {
   private:
     enum {
         MENU_TIMEOUT_MS = 5000,
+        MAX_MENUS = 4,
     };
 
     Display& m_display;
     Settings& m_settings;
 
-    std::vector<std::shared_ptr<Menu>> m_menus;
+    Menu* m_menus[MAX_MENUS];  // owned by setup(), which never returns
+    size_t m_menuCount{0};
     size_t m_activeMenu{0}, m_defaultMenu{0};
 
+    // reading the buttons and running their handlers, in microseconds. the
+    // average is kept 16 times over, so short stages don't round to 0
+    uint32_t m_buttonStageAvgUs16{0};
+    uint32_t m_buttonStageMaxUs{0};
+
+    uint32_t m_updates{0};
+    uint32_t m_redraws{0};
+
     Button m_btnUp{PIN_BTN_UP, INPUT_PULLUP};
     Button m_btnDown{PIN_BTN_DOWN, INPUT};
     Button m_btnLeft{PIN_BTN_LEFT, INPUT_PULLUP};
@@ -55,19 +104,41 @@ class MenuManager {
         ConfigureButtons();
     }
 
-    void Add(std::shared_ptr<Menu> menu) {
-        m_menus.push_back(menu);
-        m_activeMenu = m_menus.size() - 1;
+    // the active menu stays as it is, so menus that aren't needed for the
+    // first frame can be added after SetDefaultAndActivateMenu()
+    void Add(Menu& menu) {
+        if (m_menuCount < MAX_MENUS) {
+            m_menus[m_menuCount++] = &menu;
+        }
     }
 
     size_t GetActive() { return m_activeMenu; }
+    uint32_t GetButtonStageAvgUs() { return m_buttonStageAvgUs16 / 16; }
+    uint32_t GetButtonStageMaxUs() { return m_buttonStageMaxUs; }
+    uint32_t GetUpdates() { return m_updates; }
+    uint32_t GetRedraws() { return m_redraws; }
+
+    void HandleEvent(const IsrEvent& evt) {
+        m_btnUp.HandleEvent(evt);
+        m_btnDown.HandleEvent(evt);
+        m_btnLeft.HandleEvent(evt);
+        m_btnRight.HandleEvent(evt);
+    }
 
     void Update() {
+        const uint32_t buttonStageStart = micros();
+        Button::ReadInputs();
         m_btnUp.Update();
         m_btnDown.Update();
         m_btnLeft.Update();
         m_btnRight.Update();
-        m_menus[m_activeMenu]->Update();
+        UpdateButtonStageTime(micros() - buttonStageStart);
+
+        m_updates++;
+        if (m_menus[m_activeMenu]->IsRedrawDue()) {
+            m_menus[m_activeMenu]->Redraw();
+            m_redraws++;
+        }
         if (m_menus[m_activeMenu]->ShouldTimeout() &&
             m_menus[m_activeMenu]->GetTimeSinceButtonPress() >
                 MENU_TIMEOUT_MS) {
@@ -82,15 +153,27 @@ class MenuManager {
     }
 
     void ActivateMenu(const size_t menuNum) {
-        if (menuNum < m_menus.size()) {
+        if (menuNum < m_menuCount) {
             m_menus[m_activeMenu]->Hide();
             m_activeMenu = menuNum;
             m_menus[m_activeMenu]->Activate();
             m_menus[m_activeMenu]->ResetTimeSinceButtonPress();
+            m_menus[m_activeMenu]->Invalidate();
         }
     }
 
   private:
+    void UpdateButtonStageTime(const uint32_t us) {
+        // moving average over roughly the last 16 loops
+        m_buttonStageAvgUs16 += us - m_buttonStageAvgUs16 / 16;
+        m_buttonStageMaxUs = max(m_buttonStageMaxUs, us);
+    }
+
+    void ButtonHandled() {
+        m_menus[m_activeMenu]->ResetTimeSinceButtonPress();
+        m_menus[m_activeMenu]->Invalidate();
+    }
+
     void ConfigureButtons() {
         m_btnLeft.config.repeatRate = 250;
         m_btnRight.config.repeatRate = 250;
@@ -99,12 +182,12 @@ class MenuManager {
 
         m_btnUp.config.handlerFunc = [&](const Button::Event_e evt) {
             m_menus[m_activeMenu]->Up(evt);
-            m_menus[m_activeMenu]->ResetTimeSinceButtonPress();
+            ButtonHandled();
         };
 
         m_btnDown.config.handlerFunc = [&](const Button::Event_e evt) {
             m_menus[m_activeMenu]->Down(evt);
-            m_menus[m_activeMenu]->ResetTimeSinceButtonPress();
+            ButtonHandled();
         };
 
         m_btnLeft.config.handlerFunc = [&](const Button::Event_e evt) {
@@ -115,18 +198,18 @@ class MenuManager {
                 }
                 ActivateMenu(m_activeMenu - 1);
             }
-            m_menus[m_activeMenu]->ResetTimeSinceButtonPress();
+            ButtonHandled();
         };
 
         m_btnRight.config.handlerFunc = [&](const Button::Event_e evt) {
             const bool handled = m_menus[m_activeMenu]->Right(evt);
             if (!handled && (evt == Button::PRESS || evt == Button::REPEAT)) {
-                if (m_activeMenu == m_menus.size() - 1) {
+                if (m_activeMenu == m_menuCount - 1) {
                     return;
                 }
                 ActivateMenu(m_activeMenu + 1);
             }
-            m_menus[m_activeMenu]->ResetTimeSinceButtonPress();
+            ButtonHandled();
         };
     }
 };
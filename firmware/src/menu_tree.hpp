@@ -0,0 +1,64 @@
+#pragma once
+#include <Arduino.h>  // for PROGMEM
+#include <stdint.h>   // for uint8_t
+
+#include "settings_schema.hpp"
+
+enum MenuAction_e : uint8_t {
+    ACTION_INFO,
+    ACTION_VERSION,
+    TOTAL_ACTIONS,
+};
+
+enum MenuPage_e : uint8_t {
+    PAGE_MAIN,
+    PAGE_SYSTEM,
+    TOTAL_PAGES,
+};
+
+/**
+ * One entry on a page of the ConfigMenu. The pages are tables in flash:
+ * nothing about an entry is in RAM until it is shown, and its Option only
+ * exists while it is open.
+ * */
+struct MenuItem {
+    enum Type_e : uint8_t {
+        SETTING,  // id is a Setting_e, named after its key in the schema
+        ACTION,   // id is a MenuAction_e, run once when entered
+        UPDATE,   // the firmware update
+        PAGE,     // id is the MenuPage_e it opens
+    };
+
+    Type_e type;
+    uint8_t id;
+    char name[5];  // for everything but SETTING
+};
+
+struct MenuPage {
+    const MenuItem* items;  // in flash, read with memcpy_P()
+    uint8_t count;
+    MenuPage_e parent;  // where LEFT goes back to
+};
+
+static const MenuItem MENU_MAIN[] PROGMEM = {
+    {MenuItem::SETTING, SETTING_MINB, ""},
+    {MenuItem::SETTING, SETTING_MAXB, ""},
+    {MenuItem::SETTING, SETTING_CLKB, ""},
+    {MenuItem::SETTING, SETTING_WLED, ""},
+    {MenuItem::SETTING, SETTING_24HR, ""},
+    {MenuItem::SETTING, SETTING_TZ, ""},
+    {MenuItem::SETTING, SETTING_WIFI, ""},
+    {MenuItem::PAGE, PAGE_SYSTEM, "SYS"},
+};
+
+static const MenuItem MENU_SYSTEM[] PROGMEM = {
+    {MenuItem::ACTION, ACTION_INFO, "INFO"},
+    {MenuItem::ACTION, ACTION_VERSION, "VER"},
+    {MenuItem::SETTING, SETTING_DEVL, ""},
+    {MenuItem::UPDATE, 0, "UPDT"},
+};
+
+static constexpr MenuPage MENU_PAGES[TOTAL_PAGES] = {
+    {MENU_MAIN, sizeof(MENU_MAIN) / sizeof(MenuItem), PAGE_MAIN},
+    {MENU_SYSTEM, sizeof(MENU_SYSTEM) / sizeof(MenuItem), PAGE_MAIN},
+};
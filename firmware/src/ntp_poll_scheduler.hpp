@@ -0,0 +1,94 @@
+#pragma once
+#include <Arduino.h>  // for millis()
+#include <stdint.h>   // for int32_t and others
+
+#include "ring_buffer.hpp"
+
+/**
+ * Decides how long to wait between NTP polls. While the measured offset
+ * stays within tolerance the interval doubles, from MIN_POLL_S up to
+ * MAX_POLL_S; when it doesn't, the interval is halved. The RTC drift
+ * estimated from successive offsets also caps the interval, so that the
+ * error expected to build up before the next poll stays within tolerance.
+ * */
+class NtpPollScheduler {
+  public:
+    enum {
+        MIN_POLL_S = 64,
+        MAX_POLL_S = 16384,  // ~4.5 hours
+        OFFSET_TOLERANCE_MS = 100,
+        HISTORY_SIZE = 16,
+    };
+
+    struct Record {
+        uint32_t uptimeS;
+        int32_t offsetMs;  // NTP time - RTC time when the sample came in
+        uint32_t delayMs;
+        int32_t driftPpm;  // estimate after this sample
+        uint32_t pollS;    // interval chosen after this sample
+    };
+
+  private:
+    uint32_t m_pollS{MIN_POLL_S};
+    float m_driftPpm{0.0f};
+    bool m_hasDrift{false};
+    unsigned long m_millisAtRTCSet{0};
+    bool m_wasRTCSet{false};
+    uint32_t m_polls{0};
+    RingBuffer<Record, HISTORY_SIZE> m_history;
+
+  public:
+    uint32_t GetIntervalMs() { return m_pollS * 1000; }
+
+    // a poll went unanswered, don't let the interval grow on that
+    void AddTimeout() { m_polls++; }
+
+    void AddSample(const int32_t offsetMs, const uint32_t delayMs) {
+        m_polls++;
+        UpdateDrift(offsetMs);
+
+        if (abs(offsetMs) <= OFFSET_TOLERANCE_MS) {
+            m_pollS = min((uint32_t)MAX_POLL_S, m_pollS * 2);
+        } else {
+            m_pollS = max((uint32_t)MIN_POLL_S, m_pollS / 2);
+        }
+
+        // leave half of the tolerance for measurement noise
+        if (m_hasDrift && abs(m_driftPpm) >= 1.0f) {
+            const uint32_t maxByDriftS =
+                (OFFSET_TOLERANCE_MS / 2) * 1000 / abs(m_driftPpm);
+            m_pollS = max((uint32_t)MIN_POLL_S, min(m_pollS, maxByDriftS));
+        }
+
+        m_history.Push({(uint32_t)(millis() / 1000), offsetMs, delayMs,
+                        (int32_t)m_driftPpm, m_pollS});
+    }
+
+    // offsets are measured relative to the last time the RTC was set
+    void RTCWasSet() {
+        m_millisAtRTCSet = millis();
+        m_wasRTCSet = true;
+    }
+
+    int32_t GetDriftPpm() { return m_driftPpm; }
+    uint32_t GetPolls() { return m_polls; }
+    const RingBuffer<Record, HISTORY_SIZE>& GetHistory() { return m_history; }
+
+  private:
+    void UpdateDrift(const int32_t offsetMs) {
+        if (!m_wasRTCSet) {
+            return;
+        }
+
+        const float elapsedS = (millis() - m_millisAtRTCSet) / 1000.0f;
+        if (elapsedS < MIN_POLL_S / 2) {
+            return;  // too short to tell drift from measurement noise
+        }
+
+        // ms per second is 1000 ppm. a positive offset means the RTC is slow
+        const float driftPpm = offsetMs * 1000.0f / elapsedS;
+        m_driftPpm = m_hasDrift ? (m_driftPpm * 3.0f + driftPpm) / 4.0f
+                                : driftPpm;
+        m_hasDrift = true;
+    }
+};
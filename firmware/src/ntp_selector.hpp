@@ -0,0 +1,115 @@
+#pragma once
+#include <stdint.h>  // for int64_t and others
+
+#include "sntp.hpp"
+
+/**
+ * Picks one sample out of the replies of several NTP servers. A reply
+ * bounds the true time to within half of its round trip, so every sample
+ * is an interval. Marzullo's algorithm finds the range that the most
+ * intervals overlap; servers that miss it are falsetickers and are
+ * dropped, and of the rest the one with the lowest delay is used. Without
+ * a majority there is no consensus and nothing is selected.
+ * */
+class NtpSelector {
+  public:
+    enum {
+        MAX_SAMPLES = 4,
+        MIN_ERROR_US = 1000,  // server precision, keeps intervals from
+                              // collapsing to a point on a fast network
+    };
+
+  private:
+    struct Edge {
+        int64_t utcUs;
+        int8_t type;  // -1 starts an interval, +1 ends it
+    };
+
+    Sntp::Sample m_samples[MAX_SAMPLES];
+    uint8_t m_count{0};
+    uint8_t m_survivors{0};
+
+  public:
+    void Clear() { m_count = m_survivors = 0; }
+
+    void Add(const Sntp::Sample& sample) {
+        if (m_count < MAX_SAMPLES) {
+            m_samples[m_count++] = sample;
+        }
+    }
+
+    bool Select(Sntp::Sample& selected) {
+        m_survivors = 0;
+        if (!m_count) {
+            return false;
+        }
+
+        // samples arrive at different times, so compare them all at the
+        // moment the first one arrived
+        Edge edges[MAX_SAMPLES * 2];
+        for (uint8_t i = 0; i < m_count; ++i) {
+            const int64_t utcUs = UtcAtReference(m_samples[i]);
+            const int64_t errorUs = m_samples[i].delayUs / 2 + MIN_ERROR_US;
+            edges[i * 2] = {utcUs - errorUs, -1};
+            edges[i * 2 + 1] = {utcUs + errorUs, +1};
+        }
+        SortEdges(edges, m_count * 2);
+
+        int best = 0;
+        int overlapping = 0;
+        int64_t lowUs = 0;
+        int64_t highUs = 0;
+        for (uint8_t i = 0; i < m_count * 2; ++i) {
+            overlapping -= edges[i].type;
+            if (overlapping > best) {
+                // only a start can raise the count, so an end follows
+                best = overlapping;
+                lowUs = edges[i].utcUs;
+                highUs = edges[i + 1].utcUs;
+            }
+        }
+        if (best * 2 <= m_count) {
+            return false;
+        }
+
+        const Sntp::Sample* chosen = nullptr;
+        for (uint8_t i = 0; i < m_count; ++i) {
+            const int64_t utcUs = UtcAtReference(m_samples[i]);
+            const int64_t errorUs = m_samples[i].delayUs / 2 + MIN_ERROR_US;
+            if (utcUs - errorUs > highUs || utcUs + errorUs < lowUs) {
+                continue;  // falseticker
+            }
+            m_survivors++;
+            if (!chosen || m_samples[i].delayUs < chosen->delayUs) {
+                chosen = &m_samples[i];
+            }
+        }
+        selected = *chosen;
+        return true;
+    }
+
+    uint8_t GetCount() { return m_count; }
+    uint8_t GetSurvivors() { return m_survivors; }
+
+  private:
+    int64_t UtcAtReference(const Sntp::Sample& sample) {
+        return sample.utcUs -
+               (int32_t)(sample.localMicros - m_samples[0].localMicros);
+    }
+
+    // insertion sort, there are only a handful of edges. on a tie starts
+    // come first, so that intervals that only touch still overlap
+    static void SortEdges(Edge* edges, const uint8_t count) {
+        for (uint8_t i = 1; i < count; ++i) {
+            const Edge edge = edges[i];
+            int j = i - 1;
+            while (j >= 0 && (edges[j].utcUs > edge.utcUs ||
+                              (edges[j].utcUs == edge.utcUs &&
+                               edges[j].type > edge.type))) {
+                edges[j + 1] = edges[j];
+                j--;
+            }
+            edges[j + 1] = edge;
+        }
+    }
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <ESP8266WiFi.h>
+
+#include "elapsed_time.hpp"
+#include "ring_buffer.hpp"
+#include "sntp.hpp"
+
+/**
+ * One configured NTP server. The DNS lookup is cached between polls (and
+ * redone when it gets old or the server stops answering), and a short
+ * history of round-trip delays is kept so that replies held up by a busy
+ * network, which are the least accurate ones, can be skipped.
+ * */
+class NtpServer {
+  public:
+    enum {
+        DNS_CACHE_MS = 6 * 60 * 60 * 1000,
+        MAX_MISSES = 3,  // unanswered polls before looking up the name again
+        DELAY_HISTORY = 8,
+        MAX_DELAY_US = 500000,
+        DELAY_MARGIN_US = 10000,
+    };
+
+  private:
+    const char* m_name{""};
+    IPAddress m_address;
+    bool m_isResolved{false};
+    ElapsedTime m_sinceResolved;
+    uint8_t m_misses{0};
+    RingBuffer<uint32_t, DELAY_HISTORY> m_delays;
+    uint32_t m_rejected{0};
+
+  public:
+    NtpServer() = default;
+    explicit NtpServer(const char* name) : m_name(name) {}
+
+    bool Resolve(IPAddress& address) {
+        if (!m_isResolved || m_misses >= MAX_MISSES ||
+            m_sinceResolved.Ms() >= DNS_CACHE_MS) {
+            m_isResolved = WiFi.hostByName(m_name, m_address);
+            m_sinceResolved.Reset();
+            m_misses = 0;
+        }
+        address = m_address;
+        return m_isResolved;
+    }
+
+    void AddMiss() { m_misses++; }
+
+    // false if the reply took much longer than the recent best round trip
+    bool Accept(const Sntp::Sample& sample) {
+        m_misses = 0;
+
+        uint32_t minDelayUs = MAX_DELAY_US;
+        for (size_t i = 0; i < m_delays.Size(); ++i) {
+            minDelayUs = min(minDelayUs, m_delays[i]);
+        }
+        // rejected delays are kept too, so that a path that got slower for
+        // good is accepted again once it has filled the history
+        m_delays.Push(sample.delayUs);
+
+        if (sample.delayUs > MAX_DELAY_US ||
+            sample.delayUs > minDelayUs * 2 + DELAY_MARGIN_US) {
+            m_rejected++;
+            return false;
+        }
+        return true;
+    }
+
+    const char* GetName() { return m_name; }
+    uint32_t GetRejected() { return m_rejected; }
+};
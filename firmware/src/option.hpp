@@ -1,33 +1,28 @@
 #pragma once
 #include <Arduino.h>
-#include <functional>  // for std::function
-#include <vector>      // for std::vector
 
+#include "delegate.hpp"
 #include "display.hpp"
 #include "settings.hpp"
+#include "web_update.hpp"
 
 class Option {
   protected:
     const String m_name;
     bool m_isDone{false};
-    std::function<void()> m_finishFunc;
 
   public:
-    Option(const String& name, std::function<void()> finishFunc)
-        : m_name(name), m_finishFunc(finishFunc) {}
+    Option(const String& name) : m_name(name) {}
+    virtual ~Option() {}
     virtual String GetName() { return m_name; }
     virtual String GetCurrentValue() { return ""; };
     virtual void Begin(){};  // called by MenuManager on appearance
     virtual void Update() {}
     virtual void Up() {}
     virtual void Down() {}
-    virtual void Finish() {  // called by MenuManager when exiting
-        End();
-        if (m_finishFunc) {
-            m_finishFunc();
-        }
-    }
-    virtual void End() {}
+    virtual void End() {}  // called by ConfigMenu when exiting
+    virtual bool ShouldTimeout() { return true; }
+    virtual bool IsAnimated() { return false; }  // or redrawn on input only
 
     virtual bool IsDone() { return m_isDone; }
 };
@@ -36,77 +31,51 @@ class TextListOption : public Option {
   protected:
     Display& m_display;
     Settings& m_settings;
-    const std::vector<String> m_values;
+    const Setting_e m_setting;
+    const SettingInfo& m_info;
     int m_index{0};
 
   public:
     TextListOption(Display& display,
                    Settings& settings,
-                   const String& name,
-                   std::vector<String> values,
-                   std::function<void()> finishFunc)
-        : Option(name, finishFunc),
+                   const Setting_e setting)
+        : Option(SettingsSchema::Get(setting).key),
           m_display(display),
           m_settings(settings),
-          m_values(values) {}
+          m_setting(setting),
+          m_info(SettingsSchema::Get(setting)) {}
 
     virtual String GetCurrentValue() override {
-        return m_values.size() ? m_values[m_index] : "";
+        return m_info.choiceName(m_index);
     }
 
     virtual void Begin() override {
-        if (m_values.empty()) {
-            return;
-        }
-
-        if (m_values[m_index] != m_settings[m_name]) {
-            // when we come back into the menu, make sure that the setting
-            // selected is what is actually set in m_settings
-            m_index = 0;
-            for (size_t i = 0; i < m_values.size(); ++i) {
-                if (m_values[i] == m_settings[m_name]) {
-                    m_index = i;
-                    break;
-                }
-            }
-        }
+        // when we come back into the menu, make sure that the setting
+        // selected is what is actually set in m_settings
+        m_index = m_settings.Get(m_setting);
     }
 
     virtual void Update() override {
-        if (m_values.empty()) {
-            return;
-        }
-
-        m_display.DrawText(0, m_values[m_index], GRAY);
-        DrawArrows(0, m_values.size());
+        m_display.DrawText(0, GetCurrentValue(), GRAY);
+        DrawArrows(m_info.min, m_info.max + 1);
     }
 
     virtual void Up() override {
-        if (m_values.empty()) {
-            return;
-        }
-
-        if ((size_t)m_index < m_values.size() - 1) {
+        if (m_index < m_info.max) {
             m_index++;
             m_display.ScrollVertical(HEIGHT, 1);
         }
     }
     virtual void Down() override {
-        if (m_values.empty()) {
-            return;
-        }
-
-        if (m_index > 0) {
+        if (m_index > m_info.min) {
             m_index--;
             m_display.ScrollVertical(HEIGHT, -1);
         }
     }
 
     virtual void End() override {
-        if (m_values.size()) {
-            ChangeSettingToCurrentValue();
-            m_settings.Save();
-        }
+        ChangeSettingToCurrentValue();
+        m_settings.Save();
     }
 
   protected:
@@ -118,71 +87,76 @@ class TextListOption : public Option {
         m_display.DrawChar(14, CHAR_DOWN_ARROW, downColor);
     }
     virtual void ChangeSettingToCurrentValue() {
-        m_settings[GetName()] = GetCurrentValue();
+        m_settings.Set(m_setting, m_index);
     }
 };
 
 class RangeOption : public TextListOption {
-  protected:
-    int m_min{0};
-    int m_max{0};
-
   public:
-    RangeOption(Display& display,
-                Settings& settings,
-                String name,
-                const int min,
-                const int max,
-                std::function<void()> finishFunc)
-        : TextListOption(display, settings, name, {}, finishFunc),
-          m_min(min),
-          m_max(max) {}
+    RangeOption(Display& display, Settings& settings, const Setting_e setting)
+        : TextListOption(display, settings, setting) {}
     virtual String GetCurrentValue() override { return String(m_index); }
 
-    virtual void Begin() override {
-        if (m_index != m_settings[m_name].as<int>()) {
-            // when we come back into the menu, make sure that the setting
-            // selected is what is actually set in m_settings
-            m_index = m_settings[m_name].as<int>();
-        }
-    }
-
     virtual void Update() override {
         m_display.DrawText(0, String(m_index), GRAY);
-        DrawArrows(m_min, m_max);
+        DrawArrows(m_info.min, m_info.max);
     }
 
     virtual void Up() override {
-        if (m_index < m_max) {
+        if (m_index < m_info.max) {
             m_index++;
             ChangeSettingToCurrentValue();
         }
     }
     virtual void Down() override {
-        if (m_index > m_min) {
+        if (m_index > m_info.min) {
             m_index--;
             ChangeSettingToCurrentValue();
         }
     }
-
-    virtual void End() override {
-        ChangeSettingToCurrentValue();
-        m_settings.Save();
-    }
 };
 
 class OneShotOption : public Option {
+  public:
+    // enough room for a lambda that captures a handful of references
+    using RunFunc = Delegate<void(), 8 * sizeof(void*)>;
+
   private:
-    std::function<void()> m_runFuncOnce;
+    RunFunc m_runFuncOnce;
 
   public:
-    OneShotOption(String name,
-                  std::function<void()> runFuncOnce,
-                  std::function<void()> finishFunc)
-        : Option(name, finishFunc), m_runFuncOnce(runFuncOnce) {}
+    OneShotOption(String name, const RunFunc runFuncOnce)
+        : Option(name), m_runFuncOnce(runFuncOnce) {}
 
     virtual void Begin() override {
         m_runFuncOnce();
         m_isDone = true;
     }
-};
\ No newline at end of file
+};
+
+// runs WebUpdate's check, question and download while the option is open.
+// leaving the option cancels it
+class UpdateOption : public Option {
+  private:
+    WebUpdate& m_updater;
+
+  public:
+    UpdateOption(const String& name, WebUpdate& updater)
+        : Option(name), m_updater(updater) {}
+
+    virtual void Begin() override {
+        m_updater.Start();
+        m_isDone = false;
+    }
+    virtual void Update() override {
+        m_updater.Update();
+        m_isDone = !m_updater.IsActive();
+    }
+    virtual void Up() override { m_updater.Up(); }
+    virtual void Down() override { m_updater.Down(); }
+    virtual void End() override { m_updater.Cancel(); }
+
+    // the question has a timeout of its own
+    virtual bool ShouldTimeout() override { return !m_updater.IsActive(); }
+    virtual bool IsAnimated() override { return m_updater.IsActive(); }
+};
@@ -0,0 +1,165 @@
+#pragma once
+#include <stdint.h>  // for uint8_t and others
+#include <string.h>  // for memcpy()
+
+#include "i2c_bus.hpp"
+
+/**
+ * Minimal PCF8563 driver built on I2CBus. A copy of the register block is
+ * kept in RAM so that configuration registers are only written when they
+ * actually change, and the time is read with a single burst instead of
+ * one transaction per field.
+ * */
+class Pcf8563 {
+  public:
+    enum Registers_e {
+        REG_CONTROL_1 = 0x00,
+        REG_CONTROL_2 = 0x01,
+        REG_SECONDS = 0x02,
+        REG_MINUTES = 0x03,
+        REG_HOURS = 0x04,
+        REG_DAYS = 0x05,
+        REG_WEEKDAYS = 0x06,
+        REG_MONTHS = 0x07,
+        REG_YEARS = 0x08,
+        REG_ALARM_MINUTE = 0x09,
+        REG_ALARM_HOUR = 0x0A,
+        REG_ALARM_DAY = 0x0B,
+        REG_ALARM_WEEKDAY = 0x0C,
+        REG_CLKOUT = 0x0D,
+        REG_TIMER_CONTROL = 0x0E,
+        REG_TIMER = 0x0F,
+        TOTAL_REGISTERS,
+    };
+
+    enum Bits_e {
+        CONTROL_1_STOP = 0x20,   // stops the clock and resets the prescaler
+        CONTROL_2_TIE = 0x01,    // timer interrupt enable
+        CONTROL_2_TI_TP = 0x10,  // pulse INT instead of following TF
+        SECONDS_VL = 0x80,       // oscillator stopped, time is invalid
+        MONTHS_CENTURY = 0x80,
+        ALARM_DISABLED = 0x80,
+        CLKOUT_32KHZ = 0x80,
+        TIMER_ENABLED = 0x80,
+        TIMER_4096HZ = 0x00,
+        TIMER_64HZ = 0x01,
+        TIMER_1HZ = 0x02,
+        TIMER_1_60HZ = 0x03,
+    };
+
+    enum {
+        // first seconds increment after the STOP bit is released
+        FIRST_TICK_AFTER_START_US = 507874,
+    };
+
+  private:
+    enum {
+        I2C_ADDRESS = 0x51,
+    };
+
+    uint8_t m_regs[TOTAL_REGISTERS] = {0};
+    bool m_isCacheValid{false};
+
+  public:
+    Pcf8563() { I2CBus::Initialize(); }
+
+    // refresh the entire register cache in one transaction
+    bool ReadAll() {
+        m_isCacheValid = Read(REG_CONTROL_1, TOTAL_REGISTERS);
+        return m_isCacheValid;
+    }
+
+    // refresh only seconds/minutes/hours
+    bool ReadTime() { return Read(REG_SECONDS, 3); }
+
+    bool WriteTime(const uint8_t hour,
+                   const uint8_t minute,
+                   const uint8_t second) {
+        m_regs[REG_SECONDS] = ToBCD(second);
+        m_regs[REG_MINUTES] = ToBCD(minute);
+        m_regs[REG_HOURS] = ToBCD(hour);
+        return Write(REG_SECONDS, 3);
+    }
+
+    // stops the clock and loads a new time. the clock will not advance until
+    // Start() is called, and the first increment after that happens
+    // FIRST_TICK_AFTER_START_US later (the prescaler is held in reset while
+    // stopped)
+    bool PresetTime(const uint8_t hour,
+                    const uint8_t minute,
+                    const uint8_t second) {
+        m_regs[REG_CONTROL_1] = CONTROL_1_STOP;
+        m_regs[REG_SECONDS] = ToBCD(second);
+        m_regs[REG_MINUTES] = ToBCD(minute);
+        m_regs[REG_HOURS] = ToBCD(hour);
+        return Write(REG_CONTROL_1, REG_HOURS - REG_CONTROL_1 + 1);
+    }
+
+    bool Start() {
+        m_regs[REG_CONTROL_1] = 0;
+        return Write(REG_CONTROL_1, 1);
+    }
+
+    // write the control block (status, alarms, clkout and timer) using as few
+    // transactions as possible -- registers that already hold the requested
+    // value are skipped entirely
+    bool Configure(const uint8_t control2,
+                   const uint8_t timerControl,
+                   const uint8_t timerValue) {
+        uint8_t alarmsToTimer[REG_TIMER - REG_ALARM_MINUTE + 1] = {
+            ALARM_DISABLED,      ALARM_DISABLED, ALARM_DISABLED,
+            ALARM_DISABLED,      CLKOUT_32KHZ,   timerControl,
+            timerValue,
+        };
+        const uint8_t control[2] = {0, control2};
+
+        return UpdateIfChanged(REG_CONTROL_1, control, sizeof(control)) &&
+               UpdateIfChanged(REG_ALARM_MINUTE, alarmsToTimer,
+                               sizeof(alarmsToTimer));
+    }
+
+    // same register contents as a power-on reset, with the timer disabled so
+    // that the next boot is treated as a fresh one
+    bool ZeroClock() {
+        const uint8_t zero[TOTAL_REGISTERS] = {
+            0x00,           0x00,           0x00,           0x00,
+            0x00,           0x01,           0x00,           0x01,
+            0x00,           ALARM_DISABLED, ALARM_DISABLED, ALARM_DISABLED,
+            ALARM_DISABLED, CLKOUT_32KHZ,   TIMER_1_60HZ,   0x00,
+        };
+        memcpy(m_regs, zero, sizeof(zero));
+        return Write(REG_CONTROL_1, TOTAL_REGISTERS);
+    }
+
+    uint8_t GetHour() { return FromBCD(m_regs[REG_HOURS] & 0x3F); }
+    uint8_t GetMinute() { return FromBCD(m_regs[REG_MINUTES] & 0x7F); }
+    uint8_t GetSecond() { return FromBCD(m_regs[REG_SECONDS] & 0x7F); }
+    bool IsTimeValid() { return !(m_regs[REG_SECONDS] & SECONDS_VL); }
+    uint8_t GetRegister(const Registers_e reg) { return m_regs[reg]; }
+
+  private:
+    bool Read(const uint8_t first, const size_t count) {
+        return I2CBus::Read(I2C_ADDRESS, first, &m_regs[first], count);
+    }
+
+    bool Write(const uint8_t first, const size_t count) {
+        return I2CBus::Write(I2C_ADDRESS, first, &m_regs[first], count);
+    }
+
+    bool UpdateIfChanged(const uint8_t first,
+                         const uint8_t* values,
+                         const size_t count) {
+        if (m_isCacheValid && memcmp(&m_regs[first], values, count) == 0) {
+            return true;
+        }
+        memcpy(&m_regs[first], values, count);
+        return Write(first, count);
+    }
+
+    static uint8_t ToBCD(const uint8_t value) {
+        return ((value / 10) << 4) | (value % 10);
+    }
+    static uint8_t FromBCD(const uint8_t value) {
+        return ((value >> 4) * 10) + (value & 0x0F);
+    }
+};
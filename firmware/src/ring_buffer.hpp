@@ -0,0 +1,30 @@
+#pragma once
+#include <stddef.h>  // for size_t
+
+// fixed-size history that overwrites its oldest entry when full.
+// index 0 is the oldest entry, Size() - 1 the newest.
+template <typename T, size_t SIZE>
+class RingBuffer {
+  private:
+    T m_items[SIZE];
+    size_t m_next{0};
+    size_t m_count{0};
+
+  public:
+    void Push(const T& item) {
+        m_items[m_next] = item;
+        m_next = (m_next + 1) % SIZE;
+        if (m_count < SIZE) {
+            m_count++;
+        }
+    }
+
+    const T& operator[](const size_t index) const {
+        return m_items[(m_next + SIZE - m_count + index) % SIZE];
+    }
+    const T& Newest() const { return (*this)[m_count - 1]; }
+
+    size_t Size() const { return m_count; }
+    bool IsEmpty() const { return m_count == 0; }
+    void Clear() { m_next = m_count = 0; }
+};
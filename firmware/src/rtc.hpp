@@ -1,6 +1,6 @@
 #pragma once
-#include <Rtc_Pcf8563.h>
-
+#include "isr_events.hpp"
+#include "pcf8563.hpp"
 #include "settings.hpp"
 
 class Rtc {
@@ -10,19 +10,28 @@ class Rtc {
         TIMER_NUM_SECONDS = 1,  // interrupt every N seconds for time keeping
     };
 
-    Rtc_Pcf8563 m_rtc;
+    Pcf8563 m_rtc;
     Settings& m_settings;
     bool m_isInitialized{false};
+    bool m_is24Hour{false};
+    uint32_t m_initMicros{0};
     unsigned long m_millisAtInterrupt{0};
+    unsigned long m_millisAtTick{0};
+    bool m_tickPending{false};
     uint8_t m_hour{0}, m_minute{0}, m_second{0};
 
-    inline static bool m_receivedInterrupt{false};  // used by InterruptISR()
-
   public:
-    Rtc(Settings& settings) : m_settings(settings) { m_rtc.getDateTime(); }
+    Rtc(Settings& settings) : m_settings(settings) {
+        m_settings.Subscribe(SettingMask(SETTING_24HR), [this](Setting_e) {
+            m_is24Hour = m_settings.Values().is24Hour;
+        });
+    }
 
     bool IsInitialized() { return m_isInitialized; }
 
+    // duration of the Initialize() call that brought the RTC up
+    uint32_t GetInitMicros() { return m_initMicros; }
+
     void Update() {
         if (!m_isInitialized) {
             Initialize();
@@ -32,23 +41,41 @@ class Rtc {
         // occasionally seems to get confused and send interrupts once a minute,
         // so this forces us to check in with the RTC once a second if it is
         // stuck in that state
-        if (m_receivedInterrupt || Millis() > 1000) {
+        if (m_tickPending || Millis() > 1000) {
             GetTimeFromRTC();
-            m_receivedInterrupt = false;
+            m_tickPending = false;
+        }
+    }
+
+    // called by the main loop for every event drained from IsrEvents
+    void HandleEvent(const IsrEvent& evt) {
+        if (evt.type == IsrEvents::RTC_TICK) {
+            m_tickPending = true;
+            m_millisAtTick = IsrEvents::ToMillis(evt);
         }
     }
 
     int Hour() {
-        return m_settings[F("24HR")] == F("ON") ? m_hour : Conv24to12(m_hour);
+        return m_is24Hour ? m_hour : Conv24to12(m_hour);
     }
     int Hour12() { return Conv24to12(m_hour); }
+    int Hour24() { return m_hour; }
     int Minute() { return m_minute; }
     int Second() { return m_second; }
     int Millis() { return (millis() - m_millisAtInterrupt) % 1000; }
     void SetTime(uint8_t hour, uint8_t minute, uint8_t second) {
-        m_rtc.setTime(hour, minute, second);
+        m_rtc.WriteTime(hour, minute, second);
         GetTimeFromRTC();
     }
+
+    // for setting the time with sub-second accuracy: PresetTime() stops the
+    // RTC with the given time loaded, and the seconds start counting from
+    // StartClock() + Pcf8563::FIRST_TICK_AFTER_START_US
+    void PresetTime(uint8_t hour, uint8_t minute, uint8_t second) {
+        m_rtc.PresetTime(hour, minute, second);
+    }
+    void StartClock() { m_rtc.Start(); }
+
     int Conv24to12(int hour) {
         if (hour > 12) {
             hour -= 12;
@@ -58,46 +85,48 @@ class Rtc {
         return hour;
     }
 
-    void SetClockToZero() { m_rtc.zeroClock(); }
+    void SetClockToZero() { m_rtc.ZeroClock(); }
 
   private:
     void Initialize() {
-        // try to set the alarm -- if it succeeds, the RTC is booted and we can
-        // setup the 1 second timer
-        m_rtc.getDateTime();
-        m_rtc.setAlarm(1, 2, 3, 4);
-        m_rtc.enableAlarm();
-        m_rtc.getAlarm();
-        if (m_rtc.getAlarmMinute() == 1 && m_rtc.getAlarmHour() == 2 &&
-            m_rtc.getAlarmDay() == 3 && m_rtc.getAlarmWeekday() == 4) {
-            m_rtc.clearAlarm();
-
-            m_rtc.getDateTime();
-            if (m_rtc.getTimerValue() != TIMER_NUM_SECONDS) {
-                // fresh boot -- no time backup, timer was not enabled
-                m_rtc.zeroClock();
-            }
-
-            m_rtc.clearStatus();
-            m_rtc.clearTimer();
-
-            // interrupt every second, hopefully
-            m_rtc.setTimer(TIMER_NUM_SECONDS, TMR_1Hz, true);
-
-            m_isInitialized = true;
-            AttachInterrupt();
+        // a single burst read of the whole register block tells us both that
+        // the RTC is booted and how it was left configured
+        const uint32_t start = micros();
+        if (!m_rtc.ReadAll()) {
+            return;
+        }
 
-            GetTimeFromRTC();
+        if (m_rtc.GetRegister(Pcf8563::REG_TIMER) != TIMER_NUM_SECONDS) {
+            // fresh boot -- no time backup, timer was not enabled
+            m_rtc.ZeroClock();
         }
+
+        // interrupt every second, hopefully. this also clears any pending
+        // alarm/timer flags and disables the alarm
+        if (!m_rtc.Configure(Pcf8563::CONTROL_2_TIE | Pcf8563::CONTROL_2_TI_TP,
+                             Pcf8563::TIMER_ENABLED | Pcf8563::TIMER_1HZ,
+                             TIMER_NUM_SECONDS)) {
+            return;
+        }
+
+        m_isInitialized = true;
+        AttachInterrupt();
+
+        GetTimeFromRTC();
+        m_initMicros = micros() - start;
     }
 
     void GetTimeFromRTC() {
-        m_rtc.getDateTime();
-        m_hour = m_rtc.getHour();
-        m_minute = m_rtc.getMinute();
-        if (m_second != m_rtc.getSecond()) {
-            m_millisAtInterrupt = millis();
-            m_second = m_rtc.getSecond();
+        if (!m_rtc.ReadTime()) {
+            return;
+        }
+        m_hour = m_rtc.GetHour();
+        m_minute = m_rtc.GetMinute();
+        if (m_second != m_rtc.GetSecond()) {
+            // the tick timestamp is taken in the ISR, so it stays accurate
+            // even if the main loop was busy when the second rolled over
+            m_millisAtInterrupt = m_tickPending ? m_millisAtTick : millis();
+            m_second = m_rtc.GetSecond();
         }
     }
 
@@ -106,5 +135,7 @@ class Rtc {
         attachInterrupt(digitalPinToInterrupt(PIN_RTC_INTERRUPT), InterruptISR,
                         FALLING);
     }
-    static inline void IRAM_ATTR InterruptISR() { m_receivedInterrupt = true; }
+    static inline void IRAM_ATTR InterruptISR() {
+        IsrEvents::Push(IsrEvents::RTC_TICK);
+    }
 };
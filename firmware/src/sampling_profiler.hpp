@@ -0,0 +1,77 @@
+#pragma once
+#include <Arduino.h>  // for timer1, IRAM_ATTR, Print
+#include <stdint.h>   // for uint32_t
+
+#include "isr_queue.hpp"
+
+/**
+ * Finds where the CPU spends its time without instrumenting anything:
+ * timer1 interrupts SAMPLE_HZ times a second and records the address the
+ * main code was interrupted at. Once MAX_SAMPLES have been taken, Update()
+ * pauses sampling, writes them out as "PC:" lines and starts over, so the
+ * time spent printing doesn't show up in the profile.
+ *
+ * firmware/tools/profile.py turns the output into a flat profile of
+ * functions, using the ELF the samples came from. Only built into the
+ * foxie-cardclock-profile env (-D SAMPLING_PROFILER).
+ *
+ * Code that runs with interrupts off (e.g. Display::Show) can't be
+ * interrupted, so its samples land right after interrupts are enabled
+ * again, in CriticalSection's destructor.
+ * */
+class SamplingProfiler {
+  public:
+    enum {
+        SAMPLE_HZ = 1000,
+        MAX_SAMPLES = 1024,
+        TIMER_HZ = 5000000,  // 80MHz APB clock / TIM_DIV16
+        SAMPLES_PER_LINE = 8,
+    };
+
+  private:
+    inline static IsrQueue<uint32_t, MAX_SAMPLES> m_samples;
+
+  public:
+    static void Start() {
+        timer1_isr_init();
+        timer1_attachInterrupt(OnTimer);
+        timer1_enable(TIM_DIV16, TIM_EDGE, TIM_LOOP);
+        timer1_write(TIMER_HZ / SAMPLE_HZ);
+    }
+
+    static void Stop() { timer1_disable(); }
+
+    // writes the samples out once there's a full set of them
+    static void Update(Print& out) {
+        if (m_samples.Size() < MAX_SAMPLES) {
+            return;
+        }
+
+        Stop();
+        out.println(F("PROFILE SAMPLES:") + String(MAX_SAMPLES) + F(" HZ:") +
+                    String(SAMPLE_HZ));
+        uint32_t pc;
+        size_t inLine = 0;
+        String line;
+        while (m_samples.Pop(pc)) {
+            line += (inLine ? F(" ") : F("PC:")) + String(pc, HEX);
+            if (++inLine == SAMPLES_PER_LINE) {
+                out.println(line);
+                line = "";
+                inLine = 0;
+            }
+        }
+        if (inLine) {
+            out.println(line);
+        }
+        Start();
+    }
+
+  private:
+    // EPC1 holds where the level-1 interrupt we're in was taken
+    static void IRAM_ATTR OnTimer() {
+        uint32_t pc;
+        __asm__ __volatile__("rsr %0, epc1" : "=r"(pc));
+        m_samples.Push(pc);
+    }
+};
@@ -0,0 +1,163 @@
+#pragma once
+#include <Arduino.h>    // for micros(), yield()
+#include <coredecls.h>  // for esp_delay()
+#include <stdint.h>     // for uint32_t and others
+
+#include "delegate.hpp"
+#include "heap_stats.hpp"
+#include "isr_events.hpp"
+#include "loop_tracer.hpp"
+
+/**
+ * Runs the main loop's tasks when they are due, rather than calling every
+ * Update() as fast as possible. Each task has a period, and can be made due
+ * right away with RunNow() (e.g. when an interrupt queued an event for it).
+ * Between tasks, Sleep() hands the CPU to the system until the earliest
+ * deadline, waking early when an interrupt pushes an IsrEvent.
+ *
+ * The share of time spent asleep is kept for INFO. The time spent in each
+ * task and the runs that started a whole period late go in PrintReport(),
+ * in front of a LoopTracer's finer detail: each task is one of its stages,
+ * each pass through RunDueTasks() one loop.
+ * */
+class Scheduler {
+  public:
+    enum {
+        MAX_TASKS = 8,
+        EVENT_CHECK_MS = 1,  // how often a sleep checks for IsrEvents
+        IDLE_WINDOW_US = 10000000,
+    };
+
+    using TaskFunc = Delegate<void()>;
+
+    struct Stats {
+        uint32_t runs;
+        uint32_t busyUs;  // in total, wraps after ~71 minutes of run time
+        uint32_t maxUs;
+        uint32_t missed;
+    };
+
+  private:
+    struct Task {
+        const char* name;
+        TaskFunc func;
+        uint8_t heapTag;  // its allocations are counted under its name
+        uint8_t traceStage;
+        uint32_t periodUs;
+        uint32_t nextRunUs;
+        Stats stats;
+    };
+
+    Task m_tasks[MAX_TASKS];
+    size_t m_taskCount{0};
+    LoopTracer m_tracer;
+
+    uint32_t m_windowStartUs{0};
+    uint32_t m_windowIdleUs{0};
+    uint8_t m_idlePercent{0};
+
+  public:
+    Scheduler() { m_windowStartUs = micros(); }
+
+    // returns the task's id for RunNow() and GetStats(), or -1 when full.
+    // tasks run in the order they were added
+    int Add(const char* name, const uint32_t periodMs, TaskFunc func) {
+        if (m_taskCount == MAX_TASKS) {
+            return -1;
+        }
+        m_tasks[m_taskCount] = {name,
+                                func,
+                                HeapStats::AddTag(name),
+                                m_tracer.AddStage(name),
+                                periodMs * 1000,
+                                (uint32_t)micros(),
+                                {}};
+        return m_taskCount++;
+    }
+
+    void RunNow(const int task) {
+        if (task >= 0 && (size_t)task < m_taskCount) {
+            m_tasks[task].nextRunUs = micros();
+        }
+    }
+
+    void RunDueTasks() {
+        m_tracer.BeginLoop();
+        for (size_t i = 0; i < m_taskCount; ++i) {
+            Task& task = m_tasks[i];
+            const uint32_t start = micros();
+            const int32_t lateUs = start - task.nextRunUs;
+            if (lateUs < 0) {
+                continue;
+            }
+            if ((uint32_t)lateUs >= task.periodUs) {
+                task.stats.missed++;
+            }
+
+            HeapStats::SetTag(task.heapTag);
+            m_tracer.BeginStage();
+            task.func();
+            const uint32_t busyUs = m_tracer.EndStage(task.traceStage);
+            HeapStats::SetTag(HeapStats::TAG_SYSTEM);
+
+            const uint32_t end = micros();
+            task.stats.runs++;
+            task.stats.busyUs += busyUs;
+            task.stats.maxUs = max(task.stats.maxUs, busyUs);
+
+            // a task that was held up skips the runs it missed
+            task.nextRunUs += task.periodUs;
+            if ((int32_t)(task.nextRunUs - end) <= 0) {
+                task.nextRunUs = end + task.periodUs;
+            }
+        }
+        m_tracer.EndLoop();
+    }
+
+    // until the next task is due, or an interrupt queues an event
+    void Sleep() {
+        const uint32_t start = micros();
+        int32_t untilUs = INT32_MAX;
+        for (size_t i = 0; i < m_taskCount; ++i) {
+            untilUs = min(untilUs, (int32_t)(m_tasks[i].nextRunUs - start));
+        }
+
+        if (untilUs > 0) {
+            // rounded up, so that we don't wake just short of the deadline
+            esp_delay((untilUs + 999) / 1000,
+                      []() { return IsrEvents::IsEmpty(); }, EVENT_CHECK_MS);
+        } else {
+            yield();  // allow the ESP's system/WiFi code a chance to run
+        }
+
+        const uint32_t end = micros();
+        m_windowIdleUs += end - start;
+        if (end - m_windowStartUs >= IDLE_WINDOW_US) {
+            m_idlePercent =
+                (uint64_t)m_windowIdleUs * 100 / (end - m_windowStartUs);
+            m_windowStartUs = end;
+            m_windowIdleUs = 0;
+        }
+    }
+
+    // share of the last 10 seconds spent sleeping
+    uint8_t GetIdlePercent() { return m_idlePercent; }
+    size_t GetTaskCount() { return m_taskCount; }
+    const char* GetName(const size_t task) { return m_tasks[task].name; }
+    const Stats& GetStats(const size_t task) { return m_tasks[task].stats; }
+    LoopTracer& GetTracer() { return m_tracer; }
+
+    // "IDLE:<percent> <task>:<avg>/<max>US/<missed> ...", then the tracer's
+    void PrintReport(Print& out) {
+        String line = F("IDLE:") + String(m_idlePercent) + F("%");
+        for (size_t i = 0; i < m_taskCount; ++i) {
+            const Stats& stats = m_tasks[i].stats;
+            line += F(" ") + String(m_tasks[i].name) + F(":") +
+                    String(stats.runs ? stats.busyUs / stats.runs : 0) +
+                    F("/") + String(stats.maxUs) + F("US/") +
+                    String(stats.missed);
+        }
+        out.println(line);
+        m_tracer.PrintReport(out);
+    }
+};
@@ -1,69 +1,340 @@
 #pragma once
 #include <ArduinoJson.h>
 #include <LittleFS.h>
+#include <string.h>  // for memcmp()
 
+#include "delegate.hpp"
 #include "elapsed_time.hpp"
+#include "settings_journal.hpp"
+#include "settings_schema.hpp"
+#include "settings_snapshot.hpp"
 
 enum {
     MAX_SETTINGS_SIZE = 1024,
 };
 
-class Settings : public DynamicJsonDocument {
+static constexpr uint32_t SettingMask(const Setting_e setting) {
+    return 1UL << setting;
+}
+
+/**
+ * Every setting in SettingsSchema, as a native value. Values() is what the
+ * rest of the firmware reads and Set() changes it in RAM only; Save() then
+ * appends whatever differs from the last save to the SettingsJournal.
+ *
+ * At boot the values come from the RTC memory copy of the SettingsSnapshot
+ * when there is one, in which case the filesystem isn't even mounted until
+ * the first save. Otherwise the snapshot file is read and the journal is
+ * replayed on top of it. JSON is only used to import and export settings,
+ * including the settings file of older firmware.
+ *
+ * Components that depend on a setting Subscribe() to it and keep their own
+ * copy, instead of checking Settings every loop.
+ * */
+class Settings {
+  public:
+    enum Source_e {
+        FROM_DEFAULTS,
+        FROM_RTC_MEMORY,
+        FROM_FLASH,
+        FROM_LEGACY_FILE,
+    };
+
+    enum {
+        MAX_SUBSCRIBERS = 10,
+    };
+
+    using ChangeFunc = Delegate<void(Setting_e)>;
+
   private:
-    String m_filename;
-    bool m_loaded{false};
+    static constexpr const char* LEGACY_FILENAME = "/config.json";
+
+    struct Subscriber {
+        uint32_t mask;
+        ChangeFunc func;
+    };
+
+    SettingsJournal m_journal;
+    SettingValues m_values;
+    SettingValues m_savedValues;  // what the snapshot and journal hold
+    bool m_isMounted{false};
+    Source_e m_source{FROM_DEFAULTS};
+    uint32_t m_loadMicros{0};
+    uint32_t m_snapshotBytesWritten{0};
+    uint32_t m_compactions{0};
+    Subscriber m_subscribers[MAX_SUBSCRIBERS];
+    size_t m_subscriberCount{0};
+
+    static_assert(sizeof(SettingValues) == TOTAL_SETTINGS,
+                  "every setting is one byte, without padding");
+    static_assert((int)TOTAL_SETTINGS <= (int)SettingsSnapshot::MAX_SETTINGS,
+                  "the snapshot has no room for every setting");
 
   public:
-    Settings(const String filename = "/config.json")
-        : DynamicJsonDocument(MAX_SETTINGS_SIZE), m_filename(filename) {
-        LittleFS.begin();
+    Settings() {
+        const uint32_t start = micros();
         Load();
+        m_loadMicros = micros() - start;
     }
 
-    bool Load() {
-        File file = LittleFS.open(m_filename, "r");
-        m_loaded = false;
-        if (file.size() > MAX_SETTINGS_SIZE) {
-            return false;
+    void Load() {
+        LoadDefaults();
+
+        uint8_t values[TOTAL_SETTINGS];
+        size_t count = TOTAL_SETTINGS;
+        if (SettingsSnapshot::ReadFromRtc(values, count)) {
+            SetAll(values, count);
+            m_savedValues = m_values;
+            m_source = FROM_RTC_MEMORY;
+            return;
         }
 
-        DeserializationError err = deserializeJson(*this, file);
-        file.close();
+        Mount();
+        count = TOTAL_SETTINGS;
+        const bool hasSnapshot = SettingsSnapshot::ReadFromFile(values, count);
+        if (hasSnapshot) {
+            SetAll(values, count);
+        }
+        const bool hasJournal = m_journal.Replay(
+            [&](const uint8_t setting, const uint8_t value) {
+                if (setting < TOTAL_SETTINGS) {
+                    SetIfValid((Setting_e)setting, value);
+                }
+            });
 
-        m_loaded = err ? false : true;
-        return m_loaded;
+        m_source = FROM_FLASH;
+        if (!hasSnapshot && !hasJournal) {
+            File file = LittleFS.open(LEGACY_FILENAME, "r");
+            if (file && ImportJson(file)) {
+                m_source = FROM_LEGACY_FILE;
+            } else {
+                m_source = FROM_DEFAULTS;
+            }
+            file.close();
+        }
+
+        m_savedValues = m_values;
+        if (!hasSnapshot || m_journal.NeedsCompaction()) {
+            Compact();
+        } else {
+            GetAll(values);
+            SettingsSnapshot::WriteToRtc(values, TOTAL_SETTINGS);
+        }
     }
 
-    bool Save(bool force = false) {
-        if (IsSameAsSavedFile() && !force) {
+    const SettingValues& Values() { return m_values; }
+    uint8_t Get(const Setting_e setting) { return *ValuePtr(setting); }
+
+    String GetText(const Setting_e setting) {
+        const SettingInfo& info = SettingsSchema::Get(setting);
+        return info.type == SettingInfo::CHOICE ? info.choiceName(Get(setting))
+                                                : String(Get(setting));
+    }
+
+    // values outside the setting's range are clamped. subscribers hear about
+    // it right away, it's only written to flash by Save()
+    void Set(const Setting_e setting, const int value) {
+        const SettingInfo& info = SettingsSchema::Get(setting);
+        const uint8_t clamped = constrain(value, info.min, info.max);
+        if (clamped != Get(setting)) {
+            *ValuePtr(setting) = clamped;
+            Publish(setting);
+        }
+    }
+
+    // func is called with the setting whenever one in mask changes, and
+    // once for each of them right away so that the subscriber can fill its
+    // copies in one place. the list is fixed in size: subscribe once, at
+    // construction, and raise MAX_SUBSCRIBERS when the serial port says to
+    void Subscribe(const uint32_t mask, ChangeFunc func) {
+        if (m_subscriberCount < MAX_SUBSCRIBERS) {
+            m_subscribers[m_subscriberCount++] = {mask, func};
+        } else {
+            // still starts out with the right values, but misses changes
+            Serial.println(F("SETTINGS: MAX_SUBSCRIBERS REACHED, CHANGES TO ") +
+                           String(mask, HEX) + F(" ARE LOST"));
+        }
+        for (uint8_t i = 0; i < TOTAL_SETTINGS; ++i) {
+            if (mask & SettingMask((Setting_e)i)) {
+                func((Setting_e)i);
+            }
+        }
+    }
+
+    bool IsDirty() {
+        return memcmp(&m_values, &m_savedValues, sizeof(m_values)) != 0;
+    }
+
+    // only the settings that changed since the last save are written, so
+    // calling this when nothing changed costs nothing
+    bool Save() {
+        if (!IsDirty()) {
             return true;
         }
 
-        LittleFS.remove(m_filename);
-        File file = LittleFS.open(m_filename, "w+");
-        if (!file) {
+        uint8_t ids[TOTAL_SETTINGS];
+        uint8_t values[TOTAL_SETTINGS];
+        size_t changed = 0;
+        for (uint8_t i = 0; i < TOTAL_SETTINGS; ++i) {
+            const size_t offset = SettingsSchema::Get((Setting_e)i).offset;
+            const uint8_t value = ((uint8_t*)&m_values)[offset];
+            if (value != ((uint8_t*)&m_savedValues)[offset]) {
+                ids[changed] = i;
+                values[changed++] = value;
+            }
+        }
+
+        // should we be reset halfway, the next boot reads the flash copy
+        // rather than a stale RTC one
+        SettingsSnapshot::InvalidateRtc();
+        Mount();
+        if (!m_journal.Append(ids, values, changed)) {
             return false;
         }
+        m_savedValues = m_values;
 
-        const bool success = serializeJson(*this, file) > 0;
-        file.close();
+        if (m_journal.NeedsCompaction()) {
+            Compact();
+        } else {
+            GetAll(values);
+            SettingsSnapshot::WriteToRtc(values, TOTAL_SETTINGS);
+        }
+        return true;
+    }
 
-        return success;
+    // back to defaults, including the settings file of older firmware
+    void Erase() {
+        Mount();
+        m_journal.Clear();
+        SettingsSnapshot::Erase();
+        LittleFS.remove(LEGACY_FILENAME);
+        LoadDefaults();
+        m_savedValues = m_values;
+    }
+
+    // entries that are missing or out of range are left alone. older
+    // firmware stored some numbers as strings, and the time zone as a whole
+    // number of hours named UTC
+    bool ImportJson(Stream& input) {
+        DynamicJsonDocument doc(MAX_SETTINGS_SIZE);
+        if (deserializeJson(doc, input)) {
+            return false;
+        }
+        const SettingValues before = m_values;
+
+        for (uint8_t i = 0; i < TOTAL_SETTINGS; ++i) {
+            const Setting_e setting = (Setting_e)i;
+            const SettingInfo& info = SettingsSchema::Get(setting);
+            JsonVariant stored = doc[info.key];
+
+            if (info.type == SettingInfo::CHOICE) {
+                for (int choice = info.min; choice <= info.max; ++choice) {
+                    if (stored == info.choiceName(choice)) {
+                        SetIfValid(setting, choice);
+                        break;
+                    }
+                }
+            } else if (stored.is<int>()) {
+                SetIfValid(setting, stored.as<int>());
+            } else if (stored.is<const char*>()) {
+                SetIfValid(setting, String(stored.as<const char*>()).toInt());
+            }
+        }
+
+        if (!doc.containsKey(F("TZ")) && doc.containsKey(F("UTC"))) {
+            const int offset = doc[F("UTC")] | 0;
+            const TimeZonePreset* preset = TimeZone::FindLegacyPreset(offset);
+            SetIfValid(SETTING_TZ, preset ? preset - TIME_ZONE_PRESETS : 0);
+        }
+
+        for (uint8_t i = 0; i < TOTAL_SETTINGS; ++i) {
+            const size_t offset = SettingsSchema::Get((Setting_e)i).offset;
+            if (((uint8_t*)&m_values)[offset] !=
+                ((const uint8_t*)&before)[offset]) {
+                Publish((Setting_e)i);
+            }
+        }
+        return true;
+    }
+
+    void ExportJson(Print& output) {
+        DynamicJsonDocument doc(MAX_SETTINGS_SIZE);
+        for (uint8_t i = 0; i < TOTAL_SETTINGS; ++i) {
+            const Setting_e setting = (Setting_e)i;
+            const SettingInfo& info = SettingsSchema::Get(setting);
+            if (info.type == SettingInfo::CHOICE) {
+                doc[info.key] = info.choiceName(Get(setting));
+            } else {
+                doc[info.key] = Get(setting);
+            }
+        }
+        serializeJson(doc, output);
+    }
+
+    Source_e GetSource() { return m_source; }
+    uint32_t GetLoadMicros() { return m_loadMicros; }
+    uint32_t GetCompactions() { return m_compactions; }
+    uint32_t GetFlashBytesWritten() {
+        return m_journal.GetBytesWritten() + m_snapshotBytesWritten;
     }
-    bool IsLoaded() { return m_loaded; }
 
   private:
-    bool IsSameAsSavedFile() {
-        File currentFile = LittleFS.open(m_filename, "r");
-        if (currentFile.size() <= MAX_SETTINGS_SIZE) {
-            DynamicJsonDocument currentDoc(MAX_SETTINGS_SIZE);
-            DeserializationError err = deserializeJson(currentDoc, currentFile);
-            currentFile.close();
-
-            if (!err && currentDoc == *this) {
-                return true;  // file is the same
+    void Publish(const Setting_e setting) {
+        for (size_t i = 0; i < m_subscriberCount; ++i) {
+            if (m_subscribers[i].mask & SettingMask(setting)) {
+                m_subscribers[i].func(setting);
             }
         }
-        return false;  // file is different or non-existent/parsable
     }
-};
\ No newline at end of file
+
+    void Mount() {
+        if (!m_isMounted) {
+            m_isMounted = LittleFS.begin();
+        }
+    }
+
+    void LoadDefaults() {
+        for (uint8_t i = 0; i < TOTAL_SETTINGS; ++i) {
+            const Setting_e setting = (Setting_e)i;
+            *ValuePtr(setting) = SettingsSchema::Get(setting).defaultValue;
+        }
+    }
+
+    void SetIfValid(const Setting_e setting, const int value) {
+        const SettingInfo& info = SettingsSchema::Get(setting);
+        if (value >= info.min && value <= info.max) {
+            *ValuePtr(setting) = value;
+        }
+    }
+
+    void SetAll(const uint8_t* values, const size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            SetIfValid((Setting_e)i, values[i]);
+        }
+    }
+
+    void GetAll(uint8_t* values) {
+        for (uint8_t i = 0; i < TOTAL_SETTINGS; ++i) {
+            values[i] = Get((Setting_e)i);
+        }
+    }
+
+    // the journal is only cleared once the snapshot that replaces it is
+    // safely written. replaying an old journal over a newer snapshot is
+    // harmless, it ends with the same values
+    void Compact() {
+        uint8_t values[TOTAL_SETTINGS];
+        GetAll(values);
+        SettingsSnapshot::WriteToRtc(values, TOTAL_SETTINGS);
+        if (SettingsSnapshot::WriteToFile(values, TOTAL_SETTINGS)) {
+            m_journal.Clear();
+            m_snapshotBytesWritten += SettingsSnapshot::GetSize();
+            m_compactions++;
+        }
+    }
+
+    uint8_t* ValuePtr(const Setting_e setting) {
+        return reinterpret_cast<uint8_t*>(&m_values) +
+               SettingsSchema::Get(setting).offset;
+    }
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include <LittleFS.h>
+#include <stdint.h>  // for uint8_t and others
+
+#include "crc.hpp"
+
+/**
+ * Append-only log of the setting changes made since the last
+ * SettingsSnapshot. Every record holds one setting id, its new value and a
+ * CRC, so saving a change costs a 4 byte append rather than rewriting a
+ * file. Replaying the log in order on top of the snapshot gives the current
+ * values; a record cut short or corrupted by a power cut ends the replay
+ * there, and everything before it is kept.
+ *
+ * Once the log grows past COMPACT_AT_BYTES (or a damaged record was found)
+ * the owner writes a new snapshot and clears the log.
+ * */
+class SettingsJournal {
+  public:
+    enum {
+        RECORD_SIZE = 4,
+        COMPACT_AT_BYTES = 128 * RECORD_SIZE,
+    };
+
+  private:
+    enum {
+        HEADER_ID = 0xFE,  // first record of every log, value is the version
+        VERSION = 1,
+    };
+
+    static constexpr const char* FILENAME = "/settings.log";
+
+    size_t m_size{0};
+    bool m_isDamaged{false};
+    uint32_t m_bytesWritten{0};
+
+  public:
+    // calls apply(id, value) for every intact record, oldest first. false if
+    // there were no records
+    template <typename ApplyFunc>
+    bool Replay(ApplyFunc apply) {
+        File file = LittleFS.open(FILENAME, "r");
+        if (!file) {
+            return false;
+        }
+
+        uint8_t record[RECORD_SIZE];
+        m_size = 0;
+        m_isDamaged = false;
+        while (file.read(record, RECORD_SIZE) == RECORD_SIZE) {
+            if (!IsValid(record)) {
+                m_isDamaged = true;
+                break;
+            }
+            if (m_size == 0) {
+                if (record[0] != HEADER_ID || record[1] != VERSION) {
+                    break;
+                }
+            } else {
+                apply(record[0], record[1]);
+            }
+            m_size += RECORD_SIZE;
+        }
+        // a partial record at the end is what a torn append leaves behind
+        m_isDamaged = m_isDamaged || file.size() != m_size;
+        file.close();
+        return m_size > RECORD_SIZE;
+    }
+
+    bool Append(const uint8_t* ids, const uint8_t* values, const size_t count) {
+        File file = LittleFS.open(FILENAME, "a");
+        if (!file) {
+            return false;
+        }
+
+        m_size = file.size();
+        bool success = m_size > 0 || WriteRecord(file, HEADER_ID, VERSION);
+        for (size_t i = 0; i < count && success; ++i) {
+            success = WriteRecord(file, ids[i], values[i]);
+        }
+        file.close();
+        return success;
+    }
+
+    // everything in it is part of a newer snapshot
+    void Clear() {
+        LittleFS.remove(FILENAME);
+        m_size = 0;
+        m_isDamaged = false;
+    }
+
+    bool NeedsCompaction() {
+        return m_isDamaged || m_size >= COMPACT_AT_BYTES;
+    }
+
+    size_t GetSize() { return m_size; }
+    uint32_t GetBytesWritten() { return m_bytesWritten; }
+
+  private:
+    bool WriteRecord(File& file, const uint8_t id, const uint8_t value) {
+        uint8_t record[RECORD_SIZE] = {id, value};
+        const uint16_t crc = Crc16(record, 2);
+        record[2] = crc >> 8;
+        record[3] = crc & 0xFF;
+
+        if (file.write(record, RECORD_SIZE) != RECORD_SIZE) {
+            return false;
+        }
+        m_size += RECORD_SIZE;
+        m_bytesWritten += RECORD_SIZE;
+        return true;
+    }
+
+    static bool IsValid(const uint8_t* record) {
+        const uint16_t crc = Crc16(record, 2);
+        return record[2] == (crc >> 8) && record[3] == (crc & 0xFF);
+    }
+};
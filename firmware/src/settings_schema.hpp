@@ -0,0 +1,131 @@
+#pragma once
+#include <stddef.h>  // for offsetof()
+#include <stdint.h>  // for uint8_t
+
+#include "timezone.hpp"
+
+enum Brightness_e {
+    MIN_BRIGHTNESS = 4,
+    MIN_BRIGHTNESS_DEFAULT = 8,
+    MAX_BRIGHTNESS = 150,
+    MAX_BRIGHTNESS_DEFAULT = 70,
+};
+
+// these ids are stored in the settings journal, only ever add new ones to
+// the end
+enum Setting_e {
+    SETTING_MINB,
+    SETTING_MAXB,
+    SETTING_CLKB,
+    SETTING_WLED,
+    SETTING_24HR,
+    SETTING_TZ,
+    SETTING_WIFI,
+    SETTING_DEVL,
+    SETTING_COLR,
+    SETTING_MODE,
+    SETTING_WIFI_CONFIGURED,
+    TOTAL_SETTINGS,
+};
+
+enum WiFiSetting_e : uint8_t {
+    WIFI_SETTING_OFF,
+    WIFI_SETTING_ON,
+    WIFI_SETTING_CFG,
+};
+
+// the clock face's animations, stored in the MODE setting. only ever add new
+// ones to the end, the schema's range grows with TOTAL_ANIM_MODES
+enum AnimationMode_e {
+    ANIM_MODE_NORMAL,
+    ANIM_MODE_SHIMMER,
+    ANIM_MODE_RAINBOW,
+    ANIM_MODE_MARQUEE,
+    ANIM_MODE_MARQUEE_RAINBOW,
+    ANIM_MODE_BINARY,
+    ANIM_MODE_BINARY_SHIMMER,
+    TOTAL_ANIM_MODES,
+};
+
+// every setting, as a native value. read these directly in hot paths, they
+// are kept up to date by Settings::Set()
+struct SettingValues {
+    uint8_t minBrightness;
+    uint8_t maxBrightness;
+    bool clockBackground;
+    bool wifiStatusLED;
+    bool is24Hour;
+    uint8_t timeZone;  // index into TIME_ZONE_PRESETS
+    WiFiSetting_e wifi;
+    bool developerMode;
+    uint8_t color;     // position on the color wheel
+    uint8_t animMode;  // AnimationMode_e
+    bool isWiFiConfigured;
+};
+
+struct SettingInfo {
+    enum Type_e : uint8_t {
+        RANGE,   // stored as a number
+        CHOICE,  // stored as the name of the choice
+    };
+
+    const char* key;  // also the name shown in the config menu
+    Type_e type;
+    uint8_t min;
+    uint8_t max;
+    uint8_t defaultValue;
+    const char* (*choiceName)(uint8_t value);
+    size_t offset;  // of the value in SettingValues
+};
+
+class SettingsSchema {
+  private:
+    static const char* OffOnName(const uint8_t value) {
+        return value ? "ON" : "OFF";
+    }
+
+    static const char* WiFiName(const uint8_t value) {
+        static const char* names[] = {"OFF", "ON", "CFG"};
+        return names[value];
+    }
+
+    static const char* TimeZoneName(const uint8_t value) {
+        return TIME_ZONE_PRESETS[value].name;
+    }
+
+    static constexpr uint8_t LAST_TIME_ZONE =
+        sizeof(TIME_ZONE_PRESETS) / sizeof(TIME_ZONE_PRESETS[0]) - 1;
+
+    // in Setting_e order
+    static constexpr SettingInfo SETTINGS[TOTAL_SETTINGS] = {
+        {"MINB", SettingInfo::RANGE, MIN_BRIGHTNESS, MAX_BRIGHTNESS,
+         MIN_BRIGHTNESS_DEFAULT, nullptr,
+         offsetof(SettingValues, minBrightness)},
+        {"MAXB", SettingInfo::RANGE, MIN_BRIGHTNESS, MAX_BRIGHTNESS,
+         MAX_BRIGHTNESS_DEFAULT, nullptr,
+         offsetof(SettingValues, maxBrightness)},
+        {"CLKB", SettingInfo::CHOICE, 0, 1, 1, OffOnName,
+         offsetof(SettingValues, clockBackground)},
+        {"WLED", SettingInfo::CHOICE, 0, 1, 1, OffOnName,
+         offsetof(SettingValues, wifiStatusLED)},
+        {"24HR", SettingInfo::CHOICE, 0, 1, 0, OffOnName,
+         offsetof(SettingValues, is24Hour)},
+        {"TZ", SettingInfo::CHOICE, 0, LAST_TIME_ZONE, 0, TimeZoneName,
+         offsetof(SettingValues, timeZone)},
+        {"WIFI", SettingInfo::CHOICE, WIFI_SETTING_OFF, WIFI_SETTING_CFG,
+         WIFI_SETTING_OFF, WiFiName, offsetof(SettingValues, wifi)},
+        {"DEVL", SettingInfo::CHOICE, 0, 1, 0, OffOnName,
+         offsetof(SettingValues, developerMode)},
+        {"COLR", SettingInfo::RANGE, 0, 255, 0, nullptr,
+         offsetof(SettingValues, color)},
+        {"MODE", SettingInfo::RANGE, ANIM_MODE_NORMAL, TOTAL_ANIM_MODES - 1,
+         ANIM_MODE_NORMAL, nullptr, offsetof(SettingValues, animMode)},
+        {"wifi_configured", SettingInfo::RANGE, 0, 1, 0, nullptr,
+         offsetof(SettingValues, isWiFiConfigured)},
+    };
+
+  public:
+    static const SettingInfo& Get(const Setting_e setting) {
+        return SETTINGS[setting];
+    }
+};
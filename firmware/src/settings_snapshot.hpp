@@ -0,0 +1,119 @@
+#pragma once
+#include <Arduino.h>  // for ESP.rtcUserMemoryRead() and others
+#include <LittleFS.h>
+#include <stdint.h>  // for uint8_t and others
+#include <string.h>  // for memcpy()
+
+#include "crc.hpp"
+
+/**
+ * The value of every setting, in id order, as one small versioned block
+ * with a CRC. It is kept in a file and mirrored to RTC user memory, which
+ * survives resets (though not power cuts) and can be read at boot without
+ * mounting the filesystem at all.
+ * */
+class SettingsSnapshot {
+  public:
+    enum {
+        MAX_SETTINGS = 32,
+    };
+
+  private:
+    enum {
+        MAGIC = 0x5346,  // "FS"
+        VERSION = 1,
+        RTC_OFFSET = 32,  // in 4 byte blocks, OTA uses the first 128 bytes
+    };
+
+    struct Block {
+        uint16_t magic;
+        uint8_t version;
+        uint8_t count;
+        uint8_t values[MAX_SETTINGS];
+        uint16_t crc;
+        uint16_t unused;  // RTC memory is written in 4 byte blocks
+    };
+
+    static constexpr const char* FILENAME = "/settings.bin";
+    static constexpr const char* TEMP_FILENAME = "/settings.tmp";
+
+  public:
+    // on success, count is how many values the snapshot held. it can be
+    // less than requested when a snapshot from older firmware is read
+    static bool ReadFromRtc(uint8_t* values, size_t& count) {
+        Block block;
+        return ESP.rtcUserMemoryRead(RTC_OFFSET, (uint32_t*)&block,
+                                     sizeof(block)) &&
+               Unpack(block, values, count);
+    }
+
+    static bool ReadFromFile(uint8_t* values, size_t& count) {
+        File file = LittleFS.open(FILENAME, "r");
+        if (!file) {
+            return false;
+        }
+        Block block;
+        const bool isComplete =
+            file.read((uint8_t*)&block, sizeof(block)) == sizeof(block);
+        file.close();
+        return isComplete && Unpack(block, values, count);
+    }
+
+    static bool WriteToRtc(const uint8_t* values, const size_t count) {
+        Block block = Pack(values, count);
+        return ESP.rtcUserMemoryWrite(RTC_OFFSET, (uint32_t*)&block,
+                                      sizeof(block));
+    }
+
+    // the new file is written next to the old one and renamed over it, so
+    // a power cut leaves one or the other intact
+    static bool WriteToFile(const uint8_t* values, const size_t count) {
+        const Block block = Pack(values, count);
+        File file = LittleFS.open(TEMP_FILENAME, "w");
+        if (!file) {
+            return false;
+        }
+        const bool success =
+            file.write((const uint8_t*)&block, sizeof(block)) == sizeof(block);
+        file.close();
+
+        if (!success || !LittleFS.rename(TEMP_FILENAME, FILENAME)) {
+            LittleFS.remove(TEMP_FILENAME);
+            return false;
+        }
+        return true;
+    }
+
+    static void InvalidateRtc() {
+        uint32_t magic = 0;
+        ESP.rtcUserMemoryWrite(RTC_OFFSET, &magic, sizeof(magic));
+    }
+
+    static void Erase() {
+        LittleFS.remove(FILENAME);
+        LittleFS.remove(TEMP_FILENAME);
+        InvalidateRtc();
+    }
+
+    static size_t GetSize() { return sizeof(Block); }
+
+  private:
+    static Block Pack(const uint8_t* values, const size_t count) {
+        Block block = {MAGIC, VERSION,
+                       (uint8_t)min(count, (size_t)MAX_SETTINGS)};
+        memcpy(block.values, values, block.count);
+        block.crc = Crc16((const uint8_t*)&block, offsetof(Block, crc));
+        return block;
+    }
+
+    static bool Unpack(const Block& block, uint8_t* values, size_t& count) {
+        if (block.magic != MAGIC || block.version != VERSION ||
+            block.count > MAX_SETTINGS ||
+            block.crc != Crc16((const uint8_t*)&block, offsetof(Block, crc))) {
+            return false;
+        }
+        count = min(count, (size_t)block.count);
+        memcpy(values, block.values, count);
+        return true;
+    }
+};
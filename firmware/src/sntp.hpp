@@ -0,0 +1,165 @@
+#pragma once
+#include <Arduino.h>  // for micros()
+#include <WiFiUdp.h>
+#include <stdint.h>  // for int64_t and others
+
+/**
+ * A small SNTP (RFC 4330) client. Unlike NTPClient, it keeps the sub-second
+ * part of the server timestamps and compensates for the network round trip
+ * using all four timestamps of an exchange:
+ *
+ *   T1 = request sent (local)     T2 = request received (server)
+ *   T4 = reply received (local)   T3 = reply sent (server)
+ *
+ *   offset = ((T2 - T1) + (T3 - T4)) / 2
+ *   delay  = (T4 - T1) - (T3 - T2)
+ *
+ * The local timestamps come from micros(), so the result is expressed as
+ * "UTC at a given micros() value" rather than as an offset to a wall clock.
+ * Send()/Receive() never block, the caller polls Receive() until it gets a
+ * sample or decides to give up.
+ * */
+class Sntp {
+  public:
+    enum {
+        NTP_PORT = 123,
+        LOCAL_PORT = 2390,
+        PACKET_SIZE = 48,
+    };
+
+    struct Sample {
+        int64_t utcUs;         // UTC (microseconds since 1970) at localMicros
+        uint32_t localMicros;  // micros() when the reply arrived (T4)
+        uint32_t delayUs;      // network round trip, server time excluded
+    };
+
+  private:
+    enum {
+        OFFSET_ORIGINATE = 24,
+        OFFSET_RECEIVE = 32,
+        OFFSET_TRANSMIT = 40,
+        MODE_CLIENT = 3,
+        MODE_SERVER = 4,
+        VERSION = 4,
+        LEAP_NOT_SYNCED = 3,
+        MAX_STRATUM = 15,
+    };
+
+    static constexpr int64_t SECONDS_1900_TO_1970 = 2208988800LL;
+
+    WiFiUDP m_udp;
+    bool m_isOpen{false};
+    uint8_t m_packet[PACKET_SIZE];
+    uint32_t m_sentMicros{0};
+    uint32_t m_originate[2] = {0};
+
+  public:
+    bool Send(const IPAddress& server) {
+        if (!m_isOpen) {
+            m_isOpen = m_udp.begin(LOCAL_PORT);
+            if (!m_isOpen) {
+                return false;
+            }
+        }
+        Flush();
+
+        memset(m_packet, 0, PACKET_SIZE);
+        m_packet[0] = (VERSION << 3) | MODE_CLIENT;
+
+        // the server echoes our transmit timestamp back as the originate
+        // timestamp, which is how stale or spoofed replies are discarded.
+        // it is never interpreted as a time, so any unique value will do.
+        m_originate[0]++;
+        m_originate[1] = micros();
+        Write32(&m_packet[OFFSET_TRANSMIT], m_originate[0]);
+        Write32(&m_packet[OFFSET_TRANSMIT + 4], m_originate[1]);
+
+        if (!m_udp.beginPacket(server, NTP_PORT)) {
+            return false;
+        }
+        m_udp.write(m_packet, PACKET_SIZE);
+        m_sentMicros = micros();
+        return m_udp.endPacket();
+    }
+
+    bool Receive(Sample& sample) {
+        if (!m_isOpen || m_udp.parsePacket() < PACKET_SIZE) {
+            return false;
+        }
+        const uint32_t receivedMicros = micros();
+        const bool isValid =
+            m_udp.read(m_packet, PACKET_SIZE) == PACKET_SIZE &&
+            m_udp.remotePort() == NTP_PORT && IsValidReply();
+        m_udp.flush();
+        if (!isValid) {
+            return false;
+        }
+
+        // local timestamps are relative to the moment the request was sent
+        sample = Compute(0, ToUnixMicros(&m_packet[OFFSET_RECEIVE]),
+                         ToUnixMicros(&m_packet[OFFSET_TRANSMIT]),
+                         receivedMicros - m_sentMicros);
+        sample.localMicros = receivedMicros;
+        return true;
+    }
+
+    // t1 and t4 are local, t2 and t3 are UTC, all in microseconds
+    static Sample Compute(const int64_t t1,
+                          const int64_t t2,
+                          const int64_t t3,
+                          const int64_t t4) {
+        const int64_t offset = ((t2 - t1) + (t3 - t4)) / 2;
+        const int64_t delay = (t4 - t1) - (t3 - t2);
+
+        Sample sample;
+        sample.utcUs = t4 + offset;
+        sample.localMicros = t4;
+        sample.delayUs = delay > 0 ? delay : 0;
+        return sample;
+    }
+
+  private:
+    bool IsValidReply() {
+        const uint8_t leap = m_packet[0] >> 6;
+        const uint8_t mode = m_packet[0] & 0x07;
+        const uint8_t stratum = m_packet[1];
+
+        // stratum 0 is a "kiss-o'-death", the server wants us to go away
+        return mode == MODE_SERVER && leap != LEAP_NOT_SYNCED &&
+               stratum != 0 && stratum <= MAX_STRATUM &&
+               Read32(&m_packet[OFFSET_ORIGINATE]) == m_originate[0] &&
+               Read32(&m_packet[OFFSET_ORIGINATE + 4]) == m_originate[1] &&
+               Read32(&m_packet[OFFSET_TRANSMIT]) != 0;
+    }
+
+    void Flush() {
+        // drop any late replies to a previous request
+        while (m_udp.parsePacket() > 0) {
+            m_udp.flush();
+        }
+    }
+
+    static int64_t ToUnixMicros(const uint8_t* timestamp) {
+        const uint32_t seconds = Read32(timestamp);
+        const uint32_t fraction = Read32(timestamp + 4);
+
+        int64_t unixSeconds = (int64_t)seconds - SECONDS_1900_TO_1970;
+        if (!(seconds & 0x80000000)) {
+            // NTP era 1 starts in 2036
+            unixSeconds += 0x100000000LL;
+        }
+        return unixSeconds * 1000000 + (((uint64_t)fraction * 1000000) >> 32);
+    }
+
+    static uint32_t Read32(const uint8_t* data) {
+        return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+               ((uint32_t)data[2] << 8) | data[3];
+    }
+
+    static void Write32(uint8_t* data, const uint32_t value) {
+        data[0] = value >> 24;
+        data[1] = value >> 16;
+        data[2] = value >> 8;
+        data[3] = value;
+    }
+};
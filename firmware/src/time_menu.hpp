@@ -16,10 +16,15 @@ class TimeMenu : public Menu {
     int m_hour, m_minute, m_second;
     bool m_timeChanged{false};
     bool m_secondsChanged{false};
+    bool m_is24Hour{false};
 
   public:
     TimeMenu(Display& display, Rtc& rtc, Settings& settings)
-        : Menu(display, settings), m_rtc(rtc) {}
+        : Menu(display, settings), m_rtc(rtc) {
+        m_settings.Subscribe(SettingMask(SETTING_24HR), [this](Setting_e) {
+            m_is24Hour = m_settings.Values().is24Hour;
+        });
+    }
 
     virtual void Update() {
         m_display.Clear();
@@ -34,6 +39,8 @@ class TimeMenu : public Menu {
         }
 
         DrawTime();
+        // the selected digits blink every half second
+        RedrawIn(500 - m_rtc.Millis() % 500);
     }
 
     virtual void Activate() {
@@ -151,7 +158,7 @@ class TimeMenu : public Menu {
             sprintf(text, "%02d", m_second);
             m_display.DrawText(10, text, m_mode == SET_SECOND ? color : GRAY);
         } else {
-            if (m_settings[F("24HR")] == F("ON")) {
+            if (m_is24Hour) {
                 sprintf(text, "%02d", m_hour);
             } else {
                 sprintf(text, "%2d", m_rtc.Conv24to12(m_hour));
@@ -0,0 +1,436 @@
+#pragma once
+#include <Arduino.h>
+#include <stdint.h>  // for int32_t and others
+
+struct TimeZonePreset {
+    const char* name;  // shown in the config menu, 3 characters max
+    const char* posix;
+};
+
+// these are stored by index, only ever add new ones to the end. see
+// TimeZone::FindLegacyPreset() before changing the order
+static const TimeZonePreset TIME_ZONE_PRESETS[] = {
+    {"UTC", "UTC0"},
+    {"HST", "HST10"},
+    {"AK", "AKST9AKDT,M3.2.0,M11.1.0"},
+    {"PST", "PST8PDT,M3.2.0,M11.1.0"},
+    {"MST", "MST7MDT,M3.2.0,M11.1.0"},
+    {"AZ", "MST7"},
+    {"CST", "CST6CDT,M3.2.0,M11.1.0"},
+    {"EST", "EST5EDT,M3.2.0,M11.1.0"},
+    {"AST", "AST4ADT,M3.2.0,M11.1.0"},
+    {"NST", "NST3:30NDT,M3.2.0,M11.1.0"},
+    {"BRT", "<-03>3"},
+    {"GMT", "GMT0BST,M3.5.0/1,M10.5.0"},
+    {"CET", "CET-1CEST,M3.5.0,M10.5.0/3"},
+    {"EET", "EET-2EEST,M3.5.0/3,M10.5.0/4"},
+    {"MSK", "MSK-3"},
+    {"GST", "<+04>-4"},
+    {"IST", "IST-5:30"},
+    {"NPT", "<+0545>-5:45"},
+    {"ICT", "<+07>-7"},
+    {"CHN", "CST-8"},
+    {"JST", "JST-9"},
+    {"ADL", "ACST-9:30ACDT,M10.1.0,M4.1.0/3"},
+    {"SYD", "AEST-10AEDT,M10.1.0,M4.1.0/3"},
+    {"NZ", "NZST-12NZDT,M9.5.0,M4.1.0/3"},
+    // the whole hours from -12 to +14 that none of the above has, so every
+    // old UTC setting has a zone to go to
+    {"-12", "<-12>12"},
+    {"-11", "<-11>11"},
+    {"-2", "<-02>2"},
+    {"-1", "<-01>1"},
+    {"+5", "<+05>-5"},
+    {"+6", "<+06>-6"},
+    {"+11", "<+11>-11"},
+    {"+13", "<+13>-13"},
+    {"+14", "<+14>-14"},
+};
+
+/**
+ * Converts UTC to local time using a POSIX TZ string such as
+ * "PST8PDT,M3.2.0,M11.1.0". The string is parsed once by Compile(). The DST
+ * transitions for TABLE_YEARS years around the first time asked about are
+ * then computed from the parsed rules, so getting the local offset is just
+ * a search of that table. Should a later time fall outside the table, it is
+ * rebuilt around that one. Compile() can't build it, since the time zone is
+ * set at boot, before the time is known.
+ *
+ * Supported rule formats are Jn, n and Mm.w.d, each with an optional
+ * /time (which may be negative or larger than 24 hours).
+ * */
+class TimeZone {
+  public:
+    enum {
+        TABLE_YEARS = 8,
+        MAX_TRANSITIONS = TABLE_YEARS * 2,
+        SECONDS_PER_DAY = 86400,
+        SECONDS_PER_HOUR = 3600,
+    };
+
+  private:
+    struct Rule {
+        enum Type_e {
+            JULIAN_NO_LEAP,  // Jn, 1-365, Feb 29 is never counted
+            JULIAN,          // n, 0-365
+            MONTH_WEEK_DAY,  // Mm.w.d
+        };
+        uint8_t type;
+        uint8_t month;  // 1-12
+        uint8_t week;   // 1-5, 5 is the last week of the month
+        uint8_t day;    // day of week 0-6 (Sunday is 0), or day of year
+        uint16_t dayOfYear;
+        int32_t time;  // seconds after local midnight
+    };
+
+    struct Transition {
+        int64_t utc;
+        int32_t offset;  // local - UTC, in seconds, from this point on
+    };
+
+    // offsets are stored east-positive (local - UTC), which is the
+    // opposite of how they are written in TZ strings
+    int32_t m_stdOffset{0};
+    int32_t m_dstOffset{0};
+    bool m_hasDST{false};
+    Rule m_dstStart{}, m_dstEnd{};
+
+    Transition m_transitions[MAX_TRANSITIONS];
+    size_t m_numTransitions{0};
+    int32_t m_firstYear{0};
+
+  public:
+    // returns false (and falls back to UTC) if the string can't be parsed
+    bool Compile(const char* tz) {
+        m_stdOffset = m_dstOffset = 0;
+        m_hasDST = false;
+        m_numTransitions = 0;
+        m_firstYear = 0;
+
+        const char* p = tz;
+        int32_t offset;
+        if (!ParseName(p) || !ParseOffset(p, offset)) {
+            return false;
+        }
+        m_stdOffset = -offset;
+        m_dstOffset = m_stdOffset;
+        if (*p == '\0') {
+            return true;
+        }
+
+        if (!ParseName(p)) {
+            m_stdOffset = m_dstOffset = 0;
+            return false;
+        }
+        m_dstOffset = m_stdOffset + SECONDS_PER_HOUR;
+        if (*p != ',' && *p != '\0') {
+            if (!ParseOffset(p, offset)) {
+                m_stdOffset = m_dstOffset = 0;
+                return false;
+            }
+            m_dstOffset = -offset;
+        }
+
+        if (*p == '\0') {
+            // no rules given, POSIX leaves this implementation defined. use
+            // the US rules, as glibc does
+            p = ",M3.2.0,M11.1.0";
+        }
+        if (*p++ != ',' || !ParseRule(p, m_dstStart) || *p++ != ',' ||
+            !ParseRule(p, m_dstEnd) || *p != '\0') {
+            m_stdOffset = m_dstOffset = 0;
+            return false;
+        }
+
+        m_hasDST = true;
+        return true;
+    }
+
+    // local - UTC in seconds, at the given UTC time (seconds since 1970)
+    int32_t GetOffset(const int64_t utc) {
+        if (!m_hasDST) {
+            return m_stdOffset;
+        }
+
+        const Transition* transition = Find(utc);
+        return transition ? transition->offset : OffsetBeforeFirstTransition();
+    }
+
+    int64_t ToLocal(const int64_t utc) { return utc + GetOffset(utc); }
+
+    // the first UTC time after utc at which the offset changes, or 0 if the
+    // zone doesn't observe DST
+    int64_t GetNextTransition(const int64_t utc) {
+        if (!m_hasDST) {
+            return 0;
+        }
+
+        // the table always extends at least a year past utc
+        EnsureTableCovers(utc);
+        for (size_t i = 0; i < m_numTransitions; ++i) {
+            if (m_transitions[i].utc > utc) {
+                return m_transitions[i].utc;
+            }
+        }
+        return 0;
+    }
+
+    bool HasDST() { return m_hasDST; }
+    int32_t GetStandardOffset() { return m_stdOffset; }
+    int32_t GetDSTOffset() { return m_dstOffset; }
+
+    // the preset for the whole hours of the UTC setting older firmware had.
+    // USAGE.md told users to enter their DST offset (PDT = -7), so the first
+    // zone whose DST offset matches wins, then the first whose standard
+    // offset does. nullptr only outside of -12 to +14
+    static const TimeZonePreset* FindLegacyPreset(const int32_t hours) {
+        const int32_t offset = hours * SECONDS_PER_HOUR;
+        const TimeZonePreset* standardMatch = nullptr;
+        for (const auto& preset : TIME_ZONE_PRESETS) {
+            TimeZone tz;
+            if (!tz.Compile(preset.posix)) {
+                continue;
+            }
+            if (tz.HasDST() && tz.GetDSTOffset() == offset) {
+                return &preset;
+            }
+            if (!standardMatch && tz.GetStandardOffset() == offset) {
+                standardMatch = &preset;
+            }
+        }
+        return standardMatch;
+    }
+
+    // days since 1970-01-01 for a proleptic Gregorian date
+    static int32_t DaysFromCivil(int32_t year,
+                                 const uint32_t month,
+                                 const uint32_t day) {
+        year -= month <= 2;
+        const int32_t era = (year >= 0 ? year : year - 399) / 400;
+        const uint32_t yearOfEra = year - era * 400;
+        const uint32_t dayOfYear =
+            (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        const uint32_t dayOfEra =
+            yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        return era * 146097 + (int32_t)dayOfEra - 719468;
+    }
+
+    static int32_t YearFromDays(const int32_t days) {
+        const int32_t z = days + 719468;
+        const int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+        const uint32_t dayOfEra = z - era * 146097;
+        const uint32_t yearOfEra =
+            (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 -
+             dayOfEra / 146096) /
+            365;
+        const uint32_t dayOfYear =
+            dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        const uint32_t monthIndex = (5 * dayOfYear + 2) / 153;
+        return yearOfEra + era * 400 + (monthIndex >= 10);
+    }
+
+    static bool IsLeapYear(const int32_t year) {
+        return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    }
+
+  private:
+    const Transition* Find(const int64_t utc) {
+        EnsureTableCovers(utc);
+
+        // binary search for the last transition at or before utc
+        size_t low = 0, high = m_numTransitions;
+        while (low < high) {
+            const size_t mid = (low + high) / 2;
+            if (m_transitions[mid].utc <= utc) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low ? &m_transitions[low - 1] : nullptr;
+    }
+
+    int32_t OffsetBeforeFirstTransition() {
+        return m_transitions[0].offset == m_dstOffset ? m_stdOffset
+                                                      : m_dstOffset;
+    }
+
+    void EnsureTableCovers(const int64_t utc) {
+        const int32_t year = YearFromDays(FloorDiv(utc, SECONDS_PER_DAY));
+        if (m_numTransitions && year > m_firstYear &&
+            year < m_firstYear + TABLE_YEARS - 1) {
+            return;
+        }
+        BuildTable(year - 1);
+    }
+
+    void BuildTable(const int32_t firstYear) {
+        m_firstYear = firstYear;
+        m_numTransitions = 0;
+        for (int32_t year = firstYear; year < firstYear + TABLE_YEARS;
+             ++year) {
+            // a rule's time is in the local time in effect before it
+            const Transition start{
+                ToSeconds(year, m_dstStart) - m_stdOffset, m_dstOffset};
+            const Transition end{ToSeconds(year, m_dstEnd) - m_dstOffset,
+                                 m_stdOffset};
+
+            // southern hemisphere zones end DST before they start it
+            if (start.utc < end.utc) {
+                m_transitions[m_numTransitions++] = start;
+                m_transitions[m_numTransitions++] = end;
+            } else {
+                m_transitions[m_numTransitions++] = end;
+                m_transitions[m_numTransitions++] = start;
+            }
+        }
+    }
+
+    // the local time (as seconds since 1970) at which the rule fires
+    static int64_t ToSeconds(const int32_t year, const Rule& rule) {
+        int32_t days = DaysFromCivil(year, 1, 1);
+        switch (rule.type) {
+            case Rule::JULIAN_NO_LEAP:
+                days += rule.dayOfYear - 1;
+                if (IsLeapYear(year) && rule.dayOfYear >= 60) {
+                    days++;
+                }
+                break;
+
+            case Rule::JULIAN:
+                days += rule.dayOfYear;
+                break;
+
+            case Rule::MONTH_WEEK_DAY: {
+                static const uint8_t DAYS_IN_MONTH[] = {
+                    31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+                const int32_t firstOfMonth =
+                    DaysFromCivil(year, rule.month, 1);
+                // 1970-01-01 was a Thursday
+                const int32_t weekdayOfFirst = FloorMod(firstOfMonth + 4, 7);
+                int32_t dayOfMonth =
+                    1 + FloorMod(rule.day - weekdayOfFirst, 7) +
+                    (rule.week - 1) * 7;
+                const int32_t daysInMonth =
+                    DAYS_IN_MONTH[rule.month - 1] +
+                    (rule.month == 2 && IsLeapYear(year));
+                while (dayOfMonth > daysInMonth) {
+                    dayOfMonth -= 7;
+                }
+                days = firstOfMonth + dayOfMonth - 1;
+                break;
+            }
+        }
+        return (int64_t)days * SECONDS_PER_DAY + rule.time;
+    }
+
+    static bool ParseName(const char*& p) {
+        if (*p == '<') {
+            const char* start = ++p;
+            while (*p && *p != '>') {
+                ++p;
+            }
+            if (*p != '>' || p - start < 3) {
+                return false;
+            }
+            ++p;
+            return true;
+        }
+
+        const char* start = p;
+        while (isalpha(*p)) {
+            ++p;
+        }
+        return p - start >= 3;
+    }
+
+    // [+|-]hh[:mm[:ss]]
+    static bool ParseOffset(const char*& p, int32_t& seconds) {
+        int sign = 1;
+        if (*p == '+' || *p == '-') {
+            sign = *p++ == '-' ? -1 : 1;
+        }
+        if (!ParseTime(p, seconds)) {
+            return false;
+        }
+        seconds *= sign;
+        return true;
+    }
+
+    static bool ParseTime(const char*& p, int32_t& seconds) {
+        int32_t parts[3] = {0, 0, 0};
+        for (size_t i = 0; i < 3; ++i) {
+            if (!isdigit(*p)) {
+                return false;
+            }
+            parts[i] = ParseNumber(p);
+            if (*p != ':') {
+                break;
+            }
+            ++p;
+        }
+        seconds = parts[0] * SECONDS_PER_HOUR + parts[1] * 60 + parts[2];
+        return true;
+    }
+
+    static bool ParseRule(const char*& p, Rule& rule) {
+        rule = Rule();
+        if (*p == 'M') {
+            ++p;
+            rule.type = Rule::MONTH_WEEK_DAY;
+            if (!isdigit(*p)) {
+                return false;
+            }
+            rule.month = ParseNumber(p);
+            if (*p++ != '.' || !isdigit(*p)) {
+                return false;
+            }
+            rule.week = ParseNumber(p);
+            if (*p++ != '.' || !isdigit(*p)) {
+                return false;
+            }
+            rule.day = ParseNumber(p);
+            if (rule.month < 1 || rule.month > 12 || rule.week < 1 ||
+                rule.week > 5 || rule.day > 6) {
+                return false;
+            }
+        } else {
+            rule.type = Rule::JULIAN;
+            if (*p == 'J') {
+                ++p;
+                rule.type = Rule::JULIAN_NO_LEAP;
+            }
+            if (!isdigit(*p)) {
+                return false;
+            }
+            rule.dayOfYear = ParseNumber(p);
+            if (rule.type == Rule::JULIAN_NO_LEAP
+                    ? rule.dayOfYear < 1 || rule.dayOfYear > 365
+                    : rule.dayOfYear > 365) {
+                return false;
+            }
+        }
+
+        rule.time = 2 * SECONDS_PER_HOUR;  // the default is 02:00:00
+        if (*p == '/') {
+            ++p;
+            return ParseOffset(p, rule.time);
+        }
+        return true;
+    }
+
+    static int32_t ParseNumber(const char*& p) {
+        int32_t value = 0;
+        while (isdigit(*p)) {
+            value = value * 10 + (*p++ - '0');
+        }
+        return value;
+    }
+
+    static int64_t FloorDiv(const int64_t a, const int64_t b) {
+        return a / b - (a % b != 0 && (a < 0) != (b < 0));
+    }
+    static int32_t FloorMod(const int32_t a, const int32_t b) {
+        return ((a % b) + b) % b;
+    }
+};
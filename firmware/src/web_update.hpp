@@ -1,44 +1,131 @@
 #pragma once
 #include <ArduinoOTA.h>
-#include <ESP8266HTTPClient.h>
+#include <ESP8266HTTPClient.h>  // for HTTP_CODE_OK
 #include <ESP8266WiFi.h>
-#include <ESP8266WiFiMulti.h>
 #include <ESP8266httpUpdate.h>
 #include <user_interface.h>  // for ESP-specific API calls
 #include <memory>            // for std::shared_ptr
 
 #include "button.hpp"
+#include "cpu_governor.hpp"
 #include "display.hpp"
-
+#include "elapsed_time.hpp"
+#include "http_get.hpp"
+
+/**
+ * Checks the server for new firmware, asks whether to install it and
+ * installs it. Start() begins a check and Update(), called every frame
+ * while IsActive(), moves it along and draws it, so time keeping and the
+ * display carry on while we wait for WiFi, the server and the user. The
+ * TLS handshakes still block for a moment, and the download itself does
+ * until it reboots into the new firmware.
+ * */
 class WebUpdate {
   private:
+    enum {
+        MAX_REDIRECTS = 3,
+        CONFIRM_TIMEOUT_MS = 15000,
+    };
+
+    enum State_e {
+        IDLE,
+        WAITING_FOR_WIFI,
+        REQUESTING_VERSION,
+        SHOWING_MESSAGE,  // scrolls m_message, then moves to m_afterMessage
+        WAITING_FOR_CONFIRMATION,
+        DOWNLOADING,
+    };
+
     Settings& m_settings;
     Display& m_display;
-    std::shared_ptr<WiFiClientSecure> m_client;
+    std::shared_ptr<WiFiClientSecure> m_client;  // only while IsActive()
+    HttpGet m_request;
+    size_t m_redirects{0};
+
+    State_e m_state{IDLE};
+    ElapsedTime m_sinceStateChange;
+    String m_message;
+    uint32_t m_messageColor{GRAY};
+    State_e m_afterMessage{IDLE};
+
+    ElapsedTime m_sinceCheckStarted;
+    uint32_t m_lastCheckMs{0};  // to the answer, redirects and TLS included
 
   public:
     WebUpdate(Settings& settings, Display& display)
-        : m_settings(settings), m_display(display) {
-        // allocate this on initialization since it is fairly large
-        m_client = std::make_shared<WiFiClientSecure>();
-        m_client->setInsecure();
+        : m_settings(settings), m_display(display) {}
+
+    void Start() { SetState(WAITING_FOR_WIFI); }
+
+    // stops wherever the update is, without a message
+    void Cancel() { SetState(IDLE); }
+
+    bool IsActive() { return m_state != IDLE; }
+    uint32_t GetLastCheckMs() { return m_lastCheckMs; }
+
+    // UP installs once asked to. any button cancels waiting for WiFi and
+    // skips a message
+    void Up() {
+        if (m_state == WAITING_FOR_CONFIRMATION) {
+            SetState(DOWNLOADING);
+        } else {
+            Down();
+        }
     }
 
-    void Download() {
-        ElapsedTime connectTime;
-        m_display.Clear();
-        m_display.DrawText(1, F("<(I)>"), BLUE);
-        m_display.Show();
-        while (!WiFi.isConnected()) {
-            if (Button::AreAnyButtonsPressed()) {
-                m_display.DrawTextScrolling(F("Canceled"), GRAY);
-                return;
-            }
-            yield();
+    void Down() {
+        if (m_state == WAITING_FOR_WIFI ||
+            m_state == WAITING_FOR_CONFIRMATION) {
+            ShowMessage(F("Canceled"), GRAY);
+        } else if (m_state == SHOWING_MESSAGE) {
+            SetState(m_afterMessage);
         }
-        ConfigureESPHttpUpdate();
-        if (CheckForNewVersion()) {
-            BeginDownload();
+    }
+
+    void Update() {
+        switch (m_state) {
+            case IDLE:
+                break;
+
+            case WAITING_FOR_WIFI:
+                m_display.DrawText(1, F("<(I)>"), BLUE);
+                if (WiFi.isConnected()) {
+                    // the TLS client is large, so it's only around while
+                    // an update is, and is freed again back in IDLE
+                    m_client = std::make_shared<WiFiClientSecure>();
+                    m_client->setInsecure();
+                    ConfigureESPHttpUpdate();
+                    m_redirects = 0;
+                    m_sinceCheckStarted.Reset();
+                    RequestVersion(F("https://") + String(F(FW_VERSION_ADDR)));
+                }
+                break;
+
+            case REQUESTING_VERSION:
+                m_display.DrawTextCentered(F(">>"), BLUE);
+                CheckVersionResponse();
+                break;
+
+            case SHOWING_MESSAGE:
+                if (!m_display.DrawTextScrollingFrame(
+                        m_message, m_messageColor, m_sinceStateChange.Ms())) {
+                    SetState(m_afterMessage);
+                }
+                break;
+
+            case WAITING_FOR_CONFIRMATION:
+                m_display.DrawText(1, F("UP?"), ORANGE);
+                m_display.DrawChar(13, CHAR_UP_ARROW, GREEN);
+                if (m_sinceStateChange.Ms() > CONFIRM_TIMEOUT_MS) {
+                    ShowMessage(F("Canceled"), GRAY);
+                }
+                break;
+
+            case DOWNLOADING:
+                BeginDownload();
+                // only returns if the update couldn't start
+                SetState(IDLE);
+                break;
         }
     }
 
@@ -65,7 +152,7 @@ class WebUpdate {
                     String(map(progress, 0, total, 0, 100)) + F("%"), BLUE);
                 m_display.Update();
                 if (Button::AreAnyButtonsPressed() == PIN_BTN_LEFT &&
-                    m_settings[F("DEVL")] == F("ON")) {
+                    m_settings.Values().developerMode) {
                     m_display.Clear();
                     m_display.DrawTextCentered("CNCL", RED);
                     m_display.Show();
@@ -80,66 +167,78 @@ class WebUpdate {
         });
     }
 
-    bool CheckForNewVersion() {
-        size_t ver = GetVersionFromServer();
-        if (ver == 0) {
-            return false;
-        } else if (ver == FW_VERSION) {
-            m_display.DrawTextScrolling(F("Up to date, install again?"), GRAY);
-        } else {
-            m_display.DrawTextScrolling(
-                F("Press UP to install V") + String(ver), GREEN);
+    void SetState(const State_e state) {
+        if (state == IDLE) {
+            m_request.Stop();
+            m_client.reset();
         }
-
-        m_display.Clear();
-        m_display.DrawText(1, F("UP?"), ORANGE);
-        m_display.DrawChar(13, CHAR_UP_ARROW, GREEN);
-        m_display.Show();
-
-        if (Button::WaitForButtonPress(15000) != PIN_BTN_UP) {
-            m_display.DrawTextScrolling(F("Canceled"), GRAY);
-            return false;
+        if (m_state == REQUESTING_VERSION && state != REQUESTING_VERSION) {
+            m_lastCheckMs = m_sinceCheckStarted.Ms();
         }
+        // TLS and flashing are where the CPU time goes
+        CpuGovernor::Set(BOOST_UPDATE,
+                         state == REQUESTING_VERSION || state == DOWNLOADING);
+        m_state = state;
+        m_sinceStateChange.Reset();
+    }
 
-        return true;
+    void ShowMessage(const String& message,
+                     const uint32_t color,
+                     const State_e afterMessage = IDLE) {
+        m_message = message;
+        m_messageColor = color;
+        m_afterMessage = afterMessage;
+        SetState(SHOWING_MESSAGE);
     }
 
-    void BeginDownload() {
+    void RequestVersion(const String& url) {
+        // the TLS handshake blocks, so show what we're doing first
         m_display.Clear();
-        m_display.DrawTextCentered(F("<<"), BLUE);
+        m_display.DrawTextCentered(F(">>"), BLUE);
         m_display.Show();
 
-        // if successful, this will reboot before returning
-        ESPhttpUpdate.update(*m_client,
-                             F("https://") + String(F(FW_DOWNLOAD_ADDRESS)));
+        SetState(REQUESTING_VERSION);
+        m_request.Begin(*m_client, url);
     }
 
-  private:
-    size_t GetVersionFromServer() {
-        HTTPClient https;
-        https.setFollowRedirects(HTTPC_FORCE_FOLLOW_REDIRECTS);
+    void CheckVersionResponse() {
+        switch (m_request.Update()) {
+            case HttpGet::READING:
+                return;
 
-        m_display.Clear();
-        m_display.DrawTextCentered(F(">>"), BLUE);
-        m_display.Show();
+            case HttpGet::DONE:
+                break;
 
-        if (https.begin(*m_client,
-                        F("https://") + String(F(FW_VERSION_ADDR)))) {
-            const int httpCode = https.GET();
+            default:
+                ShowMessage(m_request.GetErrorString(), DARK_RED);
+                return;
+        }
 
-            // file found at server
-            if (httpCode == HTTP_CODE_OK ||
-                httpCode == HTTP_CODE_MOVED_PERMANENTLY) {
-                // success!
-                return https.getString().toInt();
+        if (m_request.IsRedirect() && m_redirects++ < MAX_REDIRECTS) {
+            RequestVersion(m_request.GetLocation());
+        } else if (m_request.GetStatus() != HTTP_CODE_OK) {
+            ShowMessage(F("HTTP ") + String(m_request.GetStatus()), DARK_RED);
+        } else {
+            const size_t version = m_request.GetBody().toInt();
+            if (version == 0) {
+                SetState(IDLE);
+            } else if (version == FW_VERSION) {
+                ShowMessage(F("Up to date, install again?"), GRAY,
+                            WAITING_FOR_CONFIRMATION);
             } else {
-                m_display.DrawTextScrolling(https.errorToString(httpCode),
-                                            DARK_RED);
+                ShowMessage(F("Press UP to install V") + String(version),
+                            GREEN, WAITING_FOR_CONFIRMATION);
             }
-
-            https.end();
         }
+    }
 
-        return 0;  // failed to get version
+    void BeginDownload() {
+        m_display.Clear();
+        m_display.DrawTextCentered(F("<<"), BLUE);
+        m_display.Show();
+
+        // if successful, this will reboot before returning
+        ESPhttpUpdate.update(*m_client,
+                             F("https://") + String(F(FW_DOWNLOAD_ADDRESS)));
     }
 };
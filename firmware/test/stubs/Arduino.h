@@ -0,0 +1,145 @@
+#pragma once
+// just enough of the ESP8266 Arduino core to build the headers under test
+// on the host. time only moves when a test moves it, see FakeClock
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <algorithm>
+#include <string>
+
+using std::max;
+using std::min;
+
+#define IRAM_ATTR
+#define PROGMEM
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+
+namespace FakeClock {
+inline uint64_t us = 0;
+inline void Advance(const uint64_t byUs) { us += byUs; }
+}  // namespace FakeClock
+
+inline unsigned long micros() { return (uint32_t)FakeClock::us; }
+inline unsigned long millis() { return (uint32_t)(FakeClock::us / 1000); }
+inline void delay(const unsigned long ms) { FakeClock::Advance(ms * 1000); }
+inline void yield() {}
+
+class String {
+  private:
+    std::string m_s;
+
+  public:
+    String() {}
+    String(const char* s) : m_s(s ? s : "") {}
+    String(const __FlashStringHelper* s)
+        : m_s(reinterpret_cast<const char*>(s)) {}
+    String(const std::string& s) : m_s(s) {}
+    explicit String(const char c) : m_s(1, c) {}
+    explicit String(const int value) : m_s(std::to_string(value)) {}
+    explicit String(const unsigned value) : m_s(std::to_string(value)) {}
+    explicit String(const long value) : m_s(std::to_string(value)) {}
+    explicit String(const unsigned long value)
+        : m_s(std::to_string(value)) {}
+
+    const char* c_str() const { return m_s.c_str(); }
+    unsigned length() const { return m_s.size(); }
+    bool isEmpty() const { return m_s.empty(); }
+    long toInt() const { return atol(m_s.c_str()); }
+
+    int indexOf(const char c, const unsigned from = 0) const {
+        return Found(m_s.find(c, from));
+    }
+    int indexOf(const String& s, const unsigned from = 0) const {
+        return Found(m_s.find(s.m_s, from));
+    }
+    String substring(const unsigned from) const {
+        return from < m_s.size() ? m_s.substr(from) : "";
+    }
+    String substring(const unsigned from, const unsigned to) const {
+        return from < m_s.size() ? m_s.substr(from, to - from) : "";
+    }
+    bool startsWith(const String& s) const { return m_s.rfind(s.m_s, 0) == 0; }
+    bool equalsIgnoreCase(const String& s) const {
+        return strcasecmp(m_s.c_str(), s.m_s.c_str()) == 0;
+    }
+    void trim() {
+        const size_t start = m_s.find_first_not_of(" \t\r\n");
+        const size_t end = m_s.find_last_not_of(" \t\r\n");
+        m_s = start == std::string::npos ? ""
+                                         : m_s.substr(start, end - start + 1);
+    }
+
+    String& operator+=(const String& s) {
+        m_s += s.m_s;
+        return *this;
+    }
+    String& operator+=(const char c) {
+        m_s += c;
+        return *this;
+    }
+    bool operator==(const String& s) const { return m_s == s.m_s; }
+    bool operator!=(const String& s) const { return m_s != s.m_s; }
+
+    friend String operator+(const String& a, const String& b) {
+        return a.m_s + b.m_s;
+    }
+
+  private:
+    static int Found(const size_t pos) {
+        return pos == std::string::npos ? -1 : (int)pos;
+    }
+};
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t written = 0;
+        while (written < size && write(buffer[written])) {
+            written++;
+        }
+        return written;
+    }
+    size_t print(const String& s) {
+        return write((const uint8_t*)s.c_str(), s.length());
+    }
+    size_t println(const String& s) { return print(s + "\r\n"); }
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+};
+
+// RTC user memory, which survives a reset but not a power cut
+class EspClass {
+  public:
+    enum {
+        RTC_USER_MEMORY_SIZE = 512,
+    };
+    uint8_t rtcMemory[RTC_USER_MEMORY_SIZE];
+
+    bool rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size) {
+        if (offset * 4 + size > RTC_USER_MEMORY_SIZE) {
+            return false;
+        }
+        memcpy(data, rtcMemory + offset * 4, size);
+        return true;
+    }
+    bool rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size) {
+        if (offset * 4 + size > RTC_USER_MEMORY_SIZE) {
+            return false;
+        }
+        memcpy(rtcMemory + offset * 4, data, size);
+        return true;
+    }
+};
+inline EspClass ESP;
@@ -0,0 +1,93 @@
+#pragma once
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <WiFiUdp.h>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0  // macOS, which has SO_NOSIGPIPE instead
+#endif
+
+// a WiFiClient over a host TCP socket, which connects blocking and then
+// reads without blocking, as the ESP8266's does
+class WiFiClient : public Stream {
+  private:
+    int m_socket{-1};
+    int m_peeked{-1};
+    bool m_isClosed{false};
+
+  public:
+    ~WiFiClient() { stop(); }
+
+    int connect(const char* host, uint16_t port) {
+        stop();
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* address;
+        if (getaddrinfo(host, std::to_string(port).c_str(), &hints,
+                        &address)) {
+            return 0;
+        }
+        m_socket = socket(AF_INET, SOCK_STREAM, 0);
+        const bool isConnected =
+            ::connect(m_socket, address->ai_addr, address->ai_addrlen) == 0;
+        freeaddrinfo(address);
+        if (!isConnected) {
+            stop();
+            return 0;
+        }
+        fcntl(m_socket, F_SETFL, O_NONBLOCK);
+        m_isClosed = false;
+        return 1;
+    }
+
+    int available() override {
+        if (m_socket < 0) {
+            return 0;
+        }
+        if (m_peeked < 0) {
+            uint8_t c;
+            const ssize_t count = recv(m_socket, &c, 1, 0);
+            if (count == 1) {
+                m_peeked = c;
+            } else if (count == 0) {
+                m_isClosed = true;
+            }
+        }
+        return m_peeked >= 0;
+    }
+
+    int read() override {
+        if (!available()) {
+            return -1;
+        }
+        const int c = m_peeked;
+        m_peeked = -1;
+        return c;
+    }
+
+    uint8_t connected() {
+        available();
+        return m_socket >= 0 && (!m_isClosed || m_peeked >= 0);
+    }
+
+    using Print::write;
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        const ssize_t sent = send(m_socket, buffer, size, MSG_NOSIGNAL);
+        return sent > 0 ? sent : 0;
+    }
+
+    void stop() {
+        if (m_socket >= 0) {
+            close(m_socket);
+        }
+        m_socket = -1;
+        m_peeked = -1;
+    }
+};
@@ -0,0 +1,13 @@
+#pragma once
+#include <Arduino.h>
+
+class IPAddress {
+  private:
+    uint32_t m_address{0};
+
+  public:
+    IPAddress() {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        : m_address(a | b << 8 | c << 16 | (uint32_t)d << 24) {}
+    operator uint32_t() const { return m_address; }
+};
@@ -0,0 +1,77 @@
+#pragma once
+#include <Arduino.h>
+
+#include <stdio.h>
+
+#include <filesystem>
+#include <string>
+
+// LittleFS over a directory on the host, which tests can get at with
+// HostPath() to damage files the way a power cut would
+class File {
+  private:
+    FILE* m_file{nullptr};
+
+  public:
+    File() {}
+    explicit File(FILE* file) : m_file(file) {}
+
+    operator bool() const { return m_file != nullptr; }
+
+    size_t read(uint8_t* buffer, size_t size) {
+        return fread(buffer, 1, size, m_file);
+    }
+    size_t write(const uint8_t* buffer, size_t size) {
+        return fwrite(buffer, 1, size, m_file);
+    }
+    size_t size() {
+        const long position = ftell(m_file);
+        fseek(m_file, 0, SEEK_END);
+        const long size = ftell(m_file);
+        fseek(m_file, position, SEEK_SET);
+        return size;
+    }
+    void close() {
+        if (m_file) {
+            fclose(m_file);
+            m_file = nullptr;
+        }
+    }
+};
+
+class FS {
+  private:
+    std::filesystem::path m_root{std::filesystem::temp_directory_path() /
+                                 "cardclock_littlefs"};
+
+  public:
+    bool begin() {
+        std::filesystem::create_directories(m_root);
+        return true;
+    }
+    void end() {}
+
+    bool format() {
+        std::filesystem::remove_all(m_root);
+        return begin();
+    }
+
+    std::string HostPath(const char* path) {
+        return (m_root / (path + (*path == '/'))).string();
+    }
+
+    File open(const char* path, const char* mode) {
+        const char* hostMode = *mode == 'r' ? "rb" : *mode == 'a' ? "ab" : "wb";
+        return File(fopen(HostPath(path).c_str(), hostMode));
+    }
+    bool exists(const char* path) {
+        return std::filesystem::exists(HostPath(path));
+    }
+    bool remove(const char* path) {
+        return ::remove(HostPath(path).c_str()) == 0;
+    }
+    bool rename(const char* from, const char* to) {
+        return ::rename(HostPath(from).c_str(), HostPath(to).c_str()) == 0;
+    }
+};
+inline FS LittleFS;
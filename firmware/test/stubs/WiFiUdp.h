@@ -0,0 +1,74 @@
+#pragma once
+#include <Arduino.h>
+#include <IPAddress.h>
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+// a WiFiUDP with the network replaced by the test: what's sent goes to
+// OnSend, and Deliver() queues a packet for parsePacket() to pick up
+class WiFiUDP : public Stream {
+  public:
+    struct Packet {
+        std::vector<uint8_t> data;
+        uint16_t port;  // the sender's for received packets, else the
+                        // destination's
+    };
+
+    inline static std::function<void(const Packet& packet)> OnSend;
+
+  private:
+    inline static std::deque<Packet> s_received;
+
+    Packet m_sending;
+    Packet m_current;
+    size_t m_readPos{0};
+
+  public:
+    static void Deliver(const Packet& packet) { s_received.push_back(packet); }
+    static void DropAll() { s_received.clear(); }
+
+    uint8_t begin(uint16_t port) { return 1; }
+    void stop() {}
+
+    int beginPacket(IPAddress ip, uint16_t port) {
+        m_sending = {{}, port};
+        return 1;
+    }
+    using Print::write;
+    size_t write(uint8_t c) override {
+        m_sending.data.push_back(c);
+        return 1;
+    }
+    int endPacket() {
+        if (OnSend) {
+            OnSend(m_sending);
+        }
+        return 1;
+    }
+
+    int parsePacket() {
+        m_current = {};
+        m_readPos = 0;
+        if (s_received.empty()) {
+            return 0;
+        }
+        m_current = s_received.front();
+        s_received.pop_front();
+        return m_current.data.size();
+    }
+    int available() override { return m_current.data.size() - m_readPos; }
+    int read() override {
+        return available() ? m_current.data[m_readPos++] : -1;
+    }
+    int read(uint8_t* buffer, size_t size) {
+        size_t count = 0;
+        while (count < size && available()) {
+            buffer[count++] = m_current.data[m_readPos++];
+        }
+        return count;
+    }
+    void flush() { m_readPos = m_current.data.size(); }
+    uint16_t remotePort() { return m_current.port; }
+};
@@ -0,0 +1,233 @@
+#include <arpa/inet.h>
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "http_get.hpp"
+
+// a local HTTP server stand-in: it accepts one connection, reads the
+// request and sends the canned response in pieces, then closes the
+// connection unless told to hang on to it
+class Server {
+  private:
+    int m_listener{-1};
+    uint16_t m_port{0};
+    std::thread m_thread;
+    std::atomic<bool> m_isReleased{false};
+
+  public:
+    std::string request;
+
+    // pieces are sent with a pause in between
+    explicit Server(std::vector<std::string> pieces, bool holdOpen = false) {
+        m_listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(m_listener, (sockaddr*)&address, sizeof(address));
+        socklen_t size = sizeof(address);
+        getsockname(m_listener, (sockaddr*)&address, &size);
+        m_port = ntohs(address.sin_port);
+        listen(m_listener, 1);
+
+        m_thread = std::thread([this, pieces, holdOpen]() {
+            const int connection = accept(m_listener, nullptr, nullptr);
+            char buffer[256];
+            while (request.find("\r\n\r\n") == std::string::npos) {
+                const ssize_t count = recv(connection, buffer, 256, 0);
+                if (count <= 0) {
+                    break;
+                }
+                request.append(buffer, count);
+            }
+            for (const std::string& piece : pieces) {
+                send(connection, piece.data(), piece.size(), MSG_NOSIGNAL);
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+            while (holdOpen && !m_isReleased) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+            close(connection);
+        });
+    }
+
+    ~Server() {
+        m_isReleased = true;
+        m_thread.join();
+        close(m_listener);
+    }
+
+    String Url(const char* path) {
+        return String("http://127.0.0.1:") + String(m_port) + path;
+    }
+};
+
+// Update() until done, as the main loop would call it
+static HttpGet::State_e Run(HttpGet& get) {
+    const auto giveUp =
+        std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (get.Update() == HttpGet::READING &&
+           std::chrono::steady_clock::now() < giveUp) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return get.GetState();
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_get() {
+    Server server({"HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n",
+                   "Content-Length: 2\r\n\r\n3", "\n"});
+    WiFiClient client;
+    HttpGet get;
+    TEST_ASSERT_TRUE(get.Begin(client, server.Url("/cardclock/version")));
+    TEST_ASSERT_EQUAL(HttpGet::DONE, Run(get));
+    TEST_ASSERT_EQUAL(200, get.GetStatus());
+    TEST_ASSERT_EQUAL_STRING("3\n", get.GetBody().c_str());
+    TEST_ASSERT_FALSE(get.IsRedirect());
+    TEST_ASSERT_EQUAL(0, server.request.find(
+                             "GET /cardclock/version HTTP/1.0\r\n"
+                             "Host: 127.0.0.1\r\n"));
+}
+
+// headers a CDN might send, several KB of them, in front of a tiny body
+void test_large_headers() {
+    std::string headers = "HTTP/1.1 200 OK\r\n";
+    for (int i = 0; i < 20; ++i) {
+        headers += "Set-Cookie: __cf_bm=" + std::string(150, 'a' + i) +
+                   "; path=/; HttpOnly\r\n";
+    }
+    headers += "Content-Security-Policy: " + std::string(4000, 'x') + "\r\n";
+    headers += "alt-svc: h3=\":443\"; ma=86400\r\ncf-ray: 1234-SJC\r\n\r\n";
+
+    Server server({headers, "3"});
+    WiFiClient client;
+    HttpGet get;
+    get.Begin(client, server.Url("/version"));
+    TEST_ASSERT_EQUAL(HttpGet::DONE, Run(get));
+    TEST_ASSERT_EQUAL(200, get.GetStatus());
+    TEST_ASSERT_EQUAL_STRING("3", get.GetBody().c_str());
+}
+
+void test_redirects() {
+    struct Case {
+        const char* location;
+        const char* expected;  // nullptr for the server's own origin
+    };
+    const Case cases[] = {
+        {"Location: /v2/version", nullptr},
+        {"location:   https://example.com/v2  ", "https://example.com/v2"},
+    };
+    for (const Case& c : cases) {
+        Server server({std::string("HTTP/1.1 302 Found\r\n") + c.location +
+                       "\r\n\r\n"});
+        WiFiClient client;
+        HttpGet get;
+        get.Begin(client, server.Url("/version"));
+        TEST_ASSERT_EQUAL(HttpGet::DONE, Run(get));
+        TEST_ASSERT_TRUE(get.IsRedirect());
+        const String expected =
+            c.expected ? String(c.expected) : server.Url("/v2/version");
+        TEST_ASSERT_EQUAL_STRING(expected.c_str(), get.GetLocation().c_str());
+    }
+}
+
+void test_not_found() {
+    Server server({"HTTP/1.0 404 Not Found\r\n\r\nnope"});
+    WiFiClient client;
+    HttpGet get;
+    get.Begin(client, server.Url("/missing"));
+    TEST_ASSERT_EQUAL(HttpGet::DONE, Run(get));
+    TEST_ASSERT_EQUAL(404, get.GetStatus());
+    TEST_ASSERT_FALSE(get.IsRedirect());
+}
+
+void test_body_too_large() {
+    Server server({"HTTP/1.1 200 OK\r\n\r\n" + std::string(1025, 'b')});
+    WiFiClient client;
+    HttpGet get;
+    get.Begin(client, server.Url("/big"));
+    TEST_ASSERT_EQUAL(HttpGet::FAILED, Run(get));
+    TEST_ASSERT_EQUAL(HttpGet::TOO_LARGE, get.GetError());
+}
+
+// a Location that doesn't fit can't be followed
+void test_location_too_large() {
+    Server server({"HTTP/1.1 302 Found\r\nLocation: /" +
+                   std::string(300, 'p') + "\r\n\r\n"});
+    WiFiClient client;
+    HttpGet get;
+    get.Begin(client, server.Url("/version"));
+    TEST_ASSERT_EQUAL(HttpGet::FAILED, Run(get));
+    TEST_ASSERT_EQUAL(HttpGet::TOO_LARGE, get.GetError());
+}
+
+void test_bad_responses() {
+    const char* responses[] = {
+        "SSH-2.0-OpenSSH\r\n\r\n",
+        "HTTP/1.1 200 OK\r\nContent-Length: 1\r\n",  // closed in the headers
+        "",
+    };
+    for (const char* response : responses) {
+        Server server({response});
+        WiFiClient client;
+        HttpGet get;
+        get.Begin(client, server.Url("/version"));
+        TEST_ASSERT_EQUAL(HttpGet::FAILED, Run(get));
+        TEST_ASSERT_EQUAL(HttpGet::BAD_RESPONSE, get.GetError());
+    }
+}
+
+void test_read_timeout() {
+    Server server({"HTTP/1.1 200 OK\r\n"}, true);
+    WiFiClient client;
+    HttpGet get;
+    get.Begin(client, server.Url("/version"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    TEST_ASSERT_EQUAL(HttpGet::READING, get.Update());
+    delay(4000);
+    TEST_ASSERT_EQUAL(HttpGet::READING, get.Update());
+    delay(1001);
+    TEST_ASSERT_EQUAL(HttpGet::FAILED, get.Update());
+    TEST_ASSERT_EQUAL(HttpGet::READ_TIMEOUT, get.GetError());
+}
+
+void test_cannot_connect() {
+    WiFiClient client;
+    HttpGet get;
+    TEST_ASSERT_FALSE(get.Begin(client, "ftp://example.com/version"));
+    TEST_ASSERT_EQUAL(HttpGet::BAD_URL, get.GetError());
+    TEST_ASSERT_FALSE(get.Begin(client, "http:///version"));
+    TEST_ASSERT_EQUAL(HttpGet::BAD_URL, get.GetError());
+
+    // nothing listens on a port that was just let go of
+    uint16_t port;
+    {
+        Server server({});
+        port = server.Url("").substring(17).toInt();
+        WiFiClient unblock;
+        unblock.connect("127.0.0.1", port);
+    }
+    TEST_ASSERT_FALSE(get.Begin(
+        client, String("http://127.0.0.1:") + String(port) + "/version"));
+    TEST_ASSERT_EQUAL(HttpGet::CONNECTION_FAILED, get.GetError());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_get);
+    RUN_TEST(test_large_headers);
+    RUN_TEST(test_redirects);
+    RUN_TEST(test_not_found);
+    RUN_TEST(test_body_too_large);
+    RUN_TEST(test_location_too_large);
+    RUN_TEST(test_bad_responses);
+    RUN_TEST(test_read_timeout);
+    RUN_TEST(test_cannot_connect);
+    return UNITY_END();
+}
@@ -0,0 +1,128 @@
+#include <unity.h>
+
+#include <atomic>
+#include <thread>
+
+#include "isr_queue.hpp"
+
+void setUp() {}
+void tearDown() {}
+
+void test_fifo_order_and_size() {
+    IsrQueue<uint32_t, 4> queue;
+    uint32_t item;
+    TEST_ASSERT_TRUE(queue.IsEmpty());
+    TEST_ASSERT_FALSE(queue.Pop(item));
+
+    for (uint32_t i = 0; i < 3; ++i) {
+        TEST_ASSERT_TRUE(queue.Push(i));
+    }
+    TEST_ASSERT_EQUAL_UINT32(3, queue.Size());
+    for (uint32_t i = 0; i < 3; ++i) {
+        TEST_ASSERT_TRUE(queue.Pop(item));
+        TEST_ASSERT_EQUAL_UINT32(i, item);
+    }
+    TEST_ASSERT_TRUE(queue.IsEmpty());
+}
+
+// the indexes run past SIZE many times over, the slots are reused
+void test_wraparound() {
+    IsrQueue<uint32_t, 8> queue;
+    uint32_t next = 0;
+    uint32_t expected = 0;
+    uint32_t item;
+    for (int lap = 0; lap < 1000; ++lap) {
+        // a different fill level every lap, so head and tail go through
+        // every position relative to each other
+        const uint32_t fill = lap % 8 + 1;
+        for (uint32_t i = 0; i < fill; ++i) {
+            TEST_ASSERT_TRUE(queue.Push(next++));
+        }
+        TEST_ASSERT_EQUAL_UINT32(fill, queue.Size());
+        while (queue.Pop(item)) {
+            TEST_ASSERT_EQUAL_UINT32(expected++, item);
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(next, expected);
+    TEST_ASSERT_EQUAL_UINT32(0, queue.GetDropped());
+}
+
+// a full queue drops new items and keeps the ones it has
+void test_drops_when_full() {
+    IsrQueue<uint32_t, 4> queue;
+    for (uint32_t i = 0; i < 10; ++i) {
+        queue.Push(i);
+    }
+    TEST_ASSERT_EQUAL_UINT32(4, queue.Size());
+    TEST_ASSERT_EQUAL_UINT32(6, queue.GetDropped());
+
+    uint32_t item;
+    for (uint32_t i = 0; i < 4; ++i) {
+        TEST_ASSERT_TRUE(queue.Pop(item));
+        TEST_ASSERT_EQUAL_UINT32(i, item);
+    }
+
+    // and takes new ones again once there's room
+    TEST_ASSERT_TRUE(queue.Push(100));
+    TEST_ASSERT_TRUE(queue.Pop(item));
+    TEST_ASSERT_EQUAL_UINT32(100, item);
+    TEST_ASSERT_EQUAL_UINT32(6, queue.GetDropped());
+}
+
+// a producer thread stands in for the ISR. whatever the consumer gets must
+// be in order, without duplicates, and with every gap counted as dropped
+void test_producer_consumer_stress() {
+    enum {
+        ITEMS = 2000000,
+    };
+    struct Item {
+        uint32_t sequence;
+        uint32_t check;  // a torn read would break sequence ^ check
+    };
+    static IsrQueue<Item, 64> queue;
+    std::atomic<bool> isDone{false};
+
+    std::thread producer([&]() {
+        for (uint32_t i = 0; i < ITEMS; ++i) {
+            queue.Push({i, ~i});
+        }
+        isDone = true;
+    });
+
+    uint32_t received = 0;
+    uint32_t gaps = 0;
+    uint32_t next = 0;
+    bool isOrdered = true;
+    bool isIntact = true;
+    Item item;
+    while (true) {
+        const bool wasDone = isDone;
+        while (queue.Pop(item)) {
+            isIntact = isIntact && item.check == ~item.sequence;
+            isOrdered = isOrdered && item.sequence >= next;
+            gaps += item.sequence - next;
+            next = item.sequence + 1;
+            received++;
+        }
+        if (wasDone) {
+            break;
+        }
+    }
+    producer.join();
+    gaps += ITEMS - next;
+
+    TEST_ASSERT_TRUE(isIntact);
+    TEST_ASSERT_TRUE(isOrdered);
+    TEST_ASSERT_EQUAL_UINT32(ITEMS, received + queue.GetDropped());
+    TEST_ASSERT_EQUAL_UINT32(queue.GetDropped(), gaps);
+    TEST_ASSERT_TRUE(queue.IsEmpty());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_fifo_order_and_size);
+    RUN_TEST(test_wraparound);
+    RUN_TEST(test_drops_when_full);
+    RUN_TEST(test_producer_consumer_stress);
+    return UNITY_END();
+}
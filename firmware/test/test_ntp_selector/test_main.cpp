@@ -0,0 +1,143 @@
+#include <unity.h>
+
+#include "ntp_selector.hpp"
+
+// the true UTC when the local micros() is 0
+static const int64_t UTC_AT_ZERO = 1700000000LL * 1000000;
+
+// a stand-in server, errorUs off from the true time, whose replies take
+// outUs to get there and backUs to come back
+struct Server {
+    int64_t errorUs;
+    int64_t outUs;
+    int64_t backUs;
+
+    // the sample from a request sent at the local time sentUs, which
+    // micros() only holds the low 32 bits of
+    Sntp::Sample Query(const int64_t sentUs) const {
+        const int64_t t1 = sentUs;
+        const int64_t t2 = UTC_AT_ZERO + t1 + outUs + errorUs;
+        const int64_t t3 = t2 + 500;  // time spent in the server
+        const int64_t t4 = t1 + outUs + 500 + backUs;
+        Sntp::Sample sample = Sntp::Compute(0, t2, t3, t4 - t1);
+        sample.localMicros = (uint32_t)t4;
+        return sample;
+    }
+};
+
+static const Server GOOD_NEAR{0, 8000, 8000};
+static const Server GOOD_FAR{300, 40000, 40000};
+static const Server SLOW{0, 400000, 400000};
+static const Server SLOW_ONE_WAY{0, 300000, 10000};
+static const Server WRONG{2000000, 10000, 10000};
+static const Server WRONG_A_BIT{80000, 5000, 5000};
+
+static int64_t TrueUtc(const uint32_t localMicros) {
+    return UTC_AT_ZERO + localMicros;
+}
+
+// each server is asked in turn, 100ms apart, as FoxieNTP does
+static bool Select(NtpSelector& selector,
+                   std::initializer_list<Server> servers,
+                   Sntp::Sample& selected,
+                   int64_t sentUs = 1000000) {
+    selector.Clear();
+    for (const Server& server : servers) {
+        selector.Add(server.Query(sentUs));
+        sentUs += 100000;
+    }
+    return selector.Select(selected);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_good_servers_agree() {
+    NtpSelector selector;
+    Sntp::Sample selected;
+    TEST_ASSERT_TRUE(
+        Select(selector, {GOOD_FAR, GOOD_NEAR, GOOD_FAR}, selected));
+    TEST_ASSERT_EQUAL(3, selector.GetSurvivors());
+    TEST_ASSERT_EQUAL_UINT32(16000, selected.delayUs);  // GOOD_NEAR's
+    TEST_ASSERT_INT64_WITHIN(1, TrueUtc(selected.localMicros),
+                             selected.utcUs);
+}
+
+// a server seconds off is a falseticker, the others outvote it
+void test_wrong_server_dropped() {
+    NtpSelector selector;
+    Sntp::Sample selected;
+    TEST_ASSERT_TRUE(Select(selector, {WRONG, GOOD_FAR, GOOD_NEAR, GOOD_FAR},
+                            selected));
+    TEST_ASSERT_EQUAL(3, selector.GetSurvivors());
+    TEST_ASSERT_INT64_WITHIN(1, TrueUtc(selected.localMicros),
+                             selected.utcUs);
+
+    // even when it has the lowest delay
+    TEST_ASSERT_TRUE(
+        Select(selector, {GOOD_FAR, GOOD_FAR, WRONG_A_BIT}, selected));
+    TEST_ASSERT_EQUAL(2, selector.GetSurvivors());
+    TEST_ASSERT_EQUAL_UINT32(80000, selected.delayUs);
+}
+
+// a slow server isn't wrong, its interval is only wider. it survives but
+// isn't picked, even when the delay is all one way
+void test_slow_server_survives() {
+    NtpSelector selector;
+    Sntp::Sample selected;
+    TEST_ASSERT_TRUE(
+        Select(selector, {SLOW, SLOW_ONE_WAY, GOOD_FAR, WRONG}, selected));
+    TEST_ASSERT_EQUAL(3, selector.GetSurvivors());
+    TEST_ASSERT_EQUAL_UINT32(80000, selected.delayUs);
+    TEST_ASSERT_INT64_WITHIN(300, TrueUtc(selected.localMicros),
+                             selected.utcUs);
+}
+
+// with no majority, no time is better than a wrong one
+void test_no_majority() {
+    NtpSelector selector;
+    Sntp::Sample selected;
+    TEST_ASSERT_FALSE(
+        Select(selector, {GOOD_NEAR, GOOD_FAR, WRONG, WRONG}, selected));
+    TEST_ASSERT_FALSE(Select(selector, {GOOD_NEAR, WRONG}, selected));
+    TEST_ASSERT_EQUAL(0, selector.GetSurvivors());
+
+    selector.Clear();
+    TEST_ASSERT_FALSE(selector.Select(selected));
+
+    // a single server is its own majority
+    TEST_ASSERT_TRUE(Select(selector, {GOOD_FAR}, selected));
+}
+
+// samples are compared at the same moment, even when micros() wrapped
+// between them
+void test_micros_wrap() {
+    NtpSelector selector;
+    Sntp::Sample selected;
+    const int64_t sentUs = 0xFFFFFFFFLL - 100000;
+    TEST_ASSERT_TRUE(Select(selector, {GOOD_FAR, GOOD_NEAR, WRONG, GOOD_FAR},
+                            selected, sentUs));
+    TEST_ASSERT_EQUAL(3, selector.GetSurvivors());
+    TEST_ASSERT_TRUE(selected.localMicros < sentUs);  // after the wrap
+    TEST_ASSERT_INT64_WITHIN(1, TrueUtc(selected.localMicros) + 0x100000000LL,
+                             selected.utcUs);
+}
+
+void test_keeps_max_samples() {
+    NtpSelector selector;
+    for (int i = 0; i < NtpSelector::MAX_SAMPLES + 2; ++i) {
+        selector.Add(GOOD_NEAR.Query(i * 100000));
+    }
+    TEST_ASSERT_EQUAL(NtpSelector::MAX_SAMPLES, selector.GetCount());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_good_servers_agree);
+    RUN_TEST(test_wrong_server_dropped);
+    RUN_TEST(test_slow_server_survives);
+    RUN_TEST(test_no_majority);
+    RUN_TEST(test_micros_wrap);
+    RUN_TEST(test_keeps_max_samples);
+    return UNITY_END();
+}
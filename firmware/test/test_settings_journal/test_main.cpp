@@ -0,0 +1,249 @@
+#include <unistd.h>
+#include <unity.h>
+
+#include <vector>
+
+#include "settings_journal.hpp"
+#include "settings_snapshot.hpp"
+
+static const char* LOG_FILE = "/settings.log";
+static const char* SNAPSHOT_FILE = "/settings.bin";
+static const char* TEMP_FILE = "/settings.tmp";
+
+struct Record {
+    uint8_t id;
+    uint8_t value;
+};
+
+static std::vector<Record> Replay(SettingsJournal& journal) {
+    std::vector<Record> records;
+    journal.Replay([&](uint8_t id, uint8_t value) {
+        records.push_back({id, value});
+    });
+    return records;
+}
+
+static void Append(SettingsJournal& journal, uint8_t id, uint8_t value) {
+    TEST_ASSERT_TRUE(journal.Append(&id, &value, 1));
+}
+
+static long FileSize(const char* path) {
+    FILE* file = fopen(LittleFS.HostPath(path).c_str(), "rb");
+    if (!file) {
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+static void FlipByte(const char* path, const long offset) {
+    FILE* file = fopen(LittleFS.HostPath(path).c_str(), "r+b");
+    fseek(file, offset, SEEK_SET);
+    const int c = fgetc(file);
+    fseek(file, offset, SEEK_SET);
+    fputc(c ^ 0x40, file);
+    fclose(file);
+}
+
+void setUp() {
+    LittleFS.format();
+    memset(ESP.rtcMemory, 0xA5, sizeof(ESP.rtcMemory));
+}
+void tearDown() {}
+
+void test_replay_in_order() {
+    SettingsJournal journal;
+    TEST_ASSERT_TRUE(Replay(journal).empty());
+
+    Append(journal, 1, 10);
+    Append(journal, 2, 20);
+    Append(journal, 1, 11);
+
+    SettingsJournal reloaded;
+    const std::vector<Record> records = Replay(reloaded);
+    TEST_ASSERT_EQUAL(3, records.size());
+    TEST_ASSERT_EQUAL(11, records[2].value);
+    TEST_ASSERT_EQUAL(4 * SettingsJournal::RECORD_SIZE, reloaded.GetSize());
+    TEST_ASSERT_FALSE(reloaded.NeedsCompaction());
+}
+
+// a power cut during an append leaves part of a record behind. everything
+// before it is kept and the log is marked for compaction
+void test_truncated_append() {
+    for (int cut = 1; cut < SettingsJournal::RECORD_SIZE; ++cut) {
+        LittleFS.format();
+        SettingsJournal journal;
+        Append(journal, 1, 10);
+        Append(journal, 2, 20);
+        truncate(LittleFS.HostPath(LOG_FILE).c_str(),
+                 FileSize(LOG_FILE) - cut);
+
+        SettingsJournal reloaded;
+        const std::vector<Record> records = Replay(reloaded);
+        TEST_ASSERT_EQUAL(1, records.size());
+        TEST_ASSERT_EQUAL(10, records[0].value);
+        TEST_ASSERT_TRUE(reloaded.NeedsCompaction());
+    }
+}
+
+// a record that fails its CRC ends the replay there, even with intact
+// records after it
+void test_corrupt_crc() {
+    SettingsJournal journal;
+    Append(journal, 1, 10);
+    Append(journal, 2, 20);
+    Append(journal, 3, 30);
+    FlipByte(LOG_FILE, 2 * SettingsJournal::RECORD_SIZE + 1);  // 2's value
+
+    SettingsJournal reloaded;
+    const std::vector<Record> records = Replay(reloaded);
+    TEST_ASSERT_EQUAL(1, records.size());
+    TEST_ASSERT_EQUAL(1, records[0].id);
+    TEST_ASSERT_TRUE(reloaded.NeedsCompaction());
+}
+
+void test_corrupt_header() {
+    SettingsJournal journal;
+    Append(journal, 1, 10);
+    FlipByte(LOG_FILE, 0);
+
+    SettingsJournal reloaded;
+    TEST_ASSERT_TRUE(Replay(reloaded).empty());
+    TEST_ASSERT_TRUE(reloaded.NeedsCompaction());
+}
+
+void test_compacts_when_full() {
+    SettingsJournal journal;
+    while (!journal.NeedsCompaction()) {
+        Append(journal, 1, journal.GetSize() & 0xFF);
+    }
+    TEST_ASSERT_EQUAL(SettingsJournal::COMPACT_AT_BYTES, journal.GetSize());
+    journal.Clear();
+    TEST_ASSERT_EQUAL(-1, FileSize(LOG_FILE));
+    TEST_ASSERT_FALSE(journal.NeedsCompaction());
+}
+
+void test_snapshot_round_trip() {
+    const uint8_t values[] = {1, 2, 3, 4, 5};
+    TEST_ASSERT_TRUE(SettingsSnapshot::WriteToFile(values, 5));
+    TEST_ASSERT_TRUE(SettingsSnapshot::WriteToRtc(values, 5));
+
+    uint8_t read[8] = {0};
+    size_t count = 8;
+    TEST_ASSERT_TRUE(SettingsSnapshot::ReadFromFile(read, count));
+    TEST_ASSERT_EQUAL(5, count);
+    TEST_ASSERT_EQUAL(5, read[4]);
+
+    count = 8;
+    TEST_ASSERT_TRUE(SettingsSnapshot::ReadFromRtc(read, count));
+    TEST_ASSERT_EQUAL(5, count);
+    SettingsSnapshot::InvalidateRtc();
+    TEST_ASSERT_FALSE(SettingsSnapshot::ReadFromRtc(read, count));
+
+    // RTC memory after a power cut is random
+    TEST_ASSERT_TRUE(SettingsSnapshot::WriteToRtc(values, 5));
+    memset(ESP.rtcMemory, 0x5A, sizeof(ESP.rtcMemory));
+    TEST_ASSERT_FALSE(SettingsSnapshot::ReadFromRtc(read, count));
+}
+
+void test_corrupt_snapshot() {
+    const uint8_t values[] = {1, 2, 3};
+    SettingsSnapshot::WriteToFile(values, 3);
+    FlipByte(SNAPSHOT_FILE, 5);
+
+    uint8_t read[3];
+    size_t count = 3;
+    TEST_ASSERT_FALSE(SettingsSnapshot::ReadFromFile(read, count));
+}
+
+// a power cut while compacting can leave the new snapshot's temp file
+// behind, cut short. the old snapshot is still the one read, and the next
+// compaction writes over the temp file
+void test_stale_compaction_file() {
+    const uint8_t oldValues[] = {1, 2, 3};
+    const uint8_t newValues[] = {7, 8, 9};
+    SettingsSnapshot::WriteToFile(oldValues, 3);
+
+    FILE* file = fopen(LittleFS.HostPath(TEMP_FILE).c_str(), "wb");
+    fwrite(newValues, 1, 3, file);
+    fclose(file);
+
+    uint8_t read[3];
+    size_t count = 3;
+    TEST_ASSERT_TRUE(SettingsSnapshot::ReadFromFile(read, count));
+    TEST_ASSERT_EQUAL(1, read[0]);
+
+    TEST_ASSERT_TRUE(SettingsSnapshot::WriteToFile(newValues, 3));
+    TEST_ASSERT_EQUAL(-1, FileSize(TEMP_FILE));
+    TEST_ASSERT_TRUE(SettingsSnapshot::ReadFromFile(read, count));
+    TEST_ASSERT_EQUAL(7, read[0]);
+}
+
+// Settings::Compact() clears the journal only after the new snapshot is
+// written. a power cut in between replays the old journal over the new
+// snapshot, which ends with the same values
+void test_cut_between_snapshot_and_clear() {
+    uint8_t values[4] = {0, 0, 0, 0};
+    SettingsJournal journal;
+    Append(journal, 1, 10);
+    Append(journal, 3, 30);
+    values[1] = 10;
+    values[3] = 30;
+    SettingsSnapshot::WriteToFile(values, 4);
+    // no journal.Clear()
+
+    uint8_t read[4];
+    size_t count = 4;
+    TEST_ASSERT_TRUE(SettingsSnapshot::ReadFromFile(read, count));
+    SettingsJournal reloaded;
+    reloaded.Replay([&](uint8_t id, uint8_t value) { read[id] = value; });
+    TEST_ASSERT_EQUAL(0, memcmp(values, read, 4));
+}
+
+// what a year of changes costs in flash, with Settings::Save()'s policy:
+// one record per changed setting, a new snapshot once the log is full.
+// the clock face saves a color or mode change 2 seconds after the last
+// button press, 20 a day is a lot of fiddling
+void test_flash_bytes_per_day() {
+    enum {
+        DAYS = 365,
+        CHANGES_PER_DAY = 20,
+    };
+    SettingsJournal journal;
+    uint32_t snapshotBytes = 0;
+    uint8_t values[SettingsSnapshot::MAX_SETTINGS] = {0};
+    for (int change = 0; change < DAYS * CHANGES_PER_DAY; ++change) {
+        values[8] = change & 0xFF;  // SETTING_COLR
+        Append(journal, 8, values[8]);
+        if (journal.NeedsCompaction()) {
+            SettingsSnapshot::WriteToFile(values, 11);
+            journal.Clear();
+            snapshotBytes += SettingsSnapshot::GetSize();
+        }
+    }
+
+    const uint32_t perDay =
+        (journal.GetBytesWritten() + snapshotBytes) / DAYS;
+    char message[64];
+    snprintf(message, sizeof(message), "%d changes a day: %u bytes a day",
+             CHANGES_PER_DAY, perDay);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_LESS_OR_EQUAL(5 * CHANGES_PER_DAY, perDay);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_replay_in_order);
+    RUN_TEST(test_truncated_append);
+    RUN_TEST(test_corrupt_crc);
+    RUN_TEST(test_corrupt_header);
+    RUN_TEST(test_compacts_when_full);
+    RUN_TEST(test_snapshot_round_trip);
+    RUN_TEST(test_corrupt_snapshot);
+    RUN_TEST(test_stale_compaction_file);
+    RUN_TEST(test_cut_between_snapshot_and_clear);
+    RUN_TEST(test_flash_bytes_per_day);
+    return UNITY_END();
+}
@@ -0,0 +1,182 @@
+#include <unity.h>
+
+#include "sntp.hpp"
+
+// the stand-in server's clock is UTC_AT_START when the local micros() is 0
+static const int64_t UTC_AT_START = 1700000000LL * 1000000;  // Nov 2023
+static const int64_t SECONDS_1900_TO_1970 = 2208988800LL;
+static const IPAddress SERVER(192, 168, 1, 2);
+
+static WiFiUDP::Packet s_request;
+
+static void Write32(uint8_t* data, const uint32_t value) {
+    data[0] = value >> 24;
+    data[1] = value >> 16;
+    data[2] = value >> 8;
+    data[3] = value;
+}
+
+static void WriteTimestamp(uint8_t* data, const int64_t utcUs) {
+    const int64_t seconds = utcUs / 1000000 + SECONDS_1900_TO_1970;
+    const uint64_t fraction = ((uint64_t)(utcUs % 1000000) << 32) / 1000000;
+    Write32(data, (uint32_t)seconds);  // wraps into era 1 from 2036 on
+    Write32(data + 4, (uint32_t)fraction + 1);  // rounds up, not down
+}
+
+// a server reply to s_request, received at t2 and sent at t3 (UTC)
+static WiFiUDP::Packet MakeReply(const int64_t t2, const int64_t t3) {
+    WiFiUDP::Packet reply{std::vector<uint8_t>(Sntp::PACKET_SIZE),
+                          Sntp::NTP_PORT};
+    uint8_t* data = reply.data.data();
+    data[0] = (4 << 3) | 4;  // version 4, server mode
+    data[1] = 2;             // stratum
+    memcpy(data + 24, s_request.data.data() + 40, 8);  // originate
+    WriteTimestamp(data + 32, t2);
+    WriteTimestamp(data + 40, t3);
+    return reply;
+}
+
+static int64_t ServerUtc() { return UTC_AT_START + (int64_t)FakeClock::us; }
+
+void setUp() {
+    FakeClock::us = 5000000;
+    s_request = {};
+    WiFiUDP::DropAll();
+    WiFiUDP::OnSend = [](const WiFiUDP::Packet& packet) {
+        s_request = packet;
+    };
+}
+void tearDown() {}
+
+void test_compute() {
+    // 10ms each way, 2ms in the server, server 500ms ahead
+    const Sntp::Sample sample = Sntp::Compute(0, 510000, 512000, 22000);
+    TEST_ASSERT_EQUAL_INT64(22000 + 500000, sample.utcUs);
+    TEST_ASSERT_EQUAL_UINT32(20000, sample.delayUs);
+}
+
+void test_request_format() {
+    Sntp sntp;
+    TEST_ASSERT_TRUE(sntp.Send(SERVER));
+    TEST_ASSERT_EQUAL(Sntp::NTP_PORT, s_request.port);
+    TEST_ASSERT_EQUAL(Sntp::PACKET_SIZE, s_request.data.size());
+    TEST_ASSERT_EQUAL_UINT8((4 << 3) | 3, s_request.data[0]);
+}
+
+// equal delays both ways cancel out, the result is the server's time
+void test_symmetric_delay() {
+    Sntp sntp;
+    sntp.Send(SERVER);
+    FakeClock::Advance(15000);
+    const int64_t t2 = ServerUtc();
+    FakeClock::Advance(3000);
+    const int64_t t3 = ServerUtc();
+    FakeClock::Advance(15000);
+    WiFiUDP::Deliver(MakeReply(t2, t3));
+
+    Sntp::Sample sample;
+    TEST_ASSERT_TRUE(sntp.Receive(sample));
+    TEST_ASSERT_EQUAL_UINT32(micros(), sample.localMicros);
+    TEST_ASSERT_INT64_WITHIN(1, ServerUtc(), sample.utcUs);
+    TEST_ASSERT_UINT32_WITHIN(1, 30000, sample.delayUs);
+}
+
+// a slow way back can't be told apart from a clock offset, the error is
+// half the difference between the two directions
+void test_asymmetric_delay() {
+    Sntp sntp;
+    sntp.Send(SERVER);
+    FakeClock::Advance(10000);
+    const int64_t t2 = ServerUtc();
+    const int64_t t3 = t2;
+    FakeClock::Advance(50000);
+    WiFiUDP::Deliver(MakeReply(t2, t3));
+
+    Sntp::Sample sample;
+    TEST_ASSERT_TRUE(sntp.Receive(sample));
+    TEST_ASSERT_INT64_WITHIN(1, ServerUtc() - 20000, sample.utcUs);
+    TEST_ASSERT_UINT32_WITHIN(1, 60000, sample.delayUs);
+}
+
+// a reply from before 2036 and one from after, in NTP era 1
+void test_era_rollover() {
+    const int64_t eras[] = {
+        2085978495LL * 1000000,  // Feb 7 2036, 06:28:15 UTC, the last era
+                                 // 0 second
+        2085978497LL * 1000000,
+        2524608000LL * 1000000,  // 2050
+    };
+    for (const int64_t utc : eras) {
+        Sntp sntp;
+        sntp.Send(SERVER);
+        WiFiUDP::Deliver(MakeReply(utc, utc));
+
+        Sntp::Sample sample;
+        TEST_ASSERT_TRUE(sntp.Receive(sample));
+        TEST_ASSERT_INT64_WITHIN(1, utc, sample.utcUs);
+    }
+}
+
+void test_rejects_bad_replies() {
+    struct Case {
+        const char* name;
+        void (*spoil)(WiFiUDP::Packet& reply);
+    };
+    const Case cases[] = {
+        {"kiss-o'-death",
+         [](WiFiUDP::Packet& reply) { reply.data[1] = 0; }},
+        {"unsynchronized",
+         [](WiFiUDP::Packet& reply) { reply.data[0] |= 3 << 6; }},
+        {"not a server",
+         [](WiFiUDP::Packet& reply) { reply.data[0] = (4 << 3) | 3; }},
+        {"stratum 16", [](WiFiUDP::Packet& reply) { reply.data[1] = 16; }},
+        {"wrong port", [](WiFiUDP::Packet& reply) { reply.port = 1234; }},
+        {"other request",
+         [](WiFiUDP::Packet& reply) { reply.data[31] ^= 1; }},
+        {"no transmit time",
+         [](WiFiUDP::Packet& reply) { memset(&reply.data[40], 0, 8); }},
+        {"short", [](WiFiUDP::Packet& reply) { reply.data.resize(40); }},
+    };
+    for (const Case& c : cases) {
+        Sntp sntp;
+        sntp.Send(SERVER);
+        WiFiUDP::Packet reply = MakeReply(ServerUtc(), ServerUtc());
+        c.spoil(reply);
+        WiFiUDP::Deliver(reply);
+
+        Sntp::Sample sample;
+        TEST_ASSERT_FALSE_MESSAGE(sntp.Receive(sample), c.name);
+    }
+}
+
+// a late reply to the last request is thrown away by the next Send(), and
+// couldn't be taken for the reply to the new one anyway
+void test_stale_reply() {
+    Sntp sntp;
+    sntp.Send(SERVER);
+    const WiFiUDP::Packet stale = MakeReply(ServerUtc(), ServerUtc());
+    FakeClock::Advance(1000000);
+
+    WiFiUDP::Deliver(stale);
+    sntp.Send(SERVER);
+    Sntp::Sample sample;
+    TEST_ASSERT_FALSE(sntp.Receive(sample));
+
+    WiFiUDP::Deliver(stale);
+    TEST_ASSERT_FALSE(sntp.Receive(sample));
+
+    WiFiUDP::Deliver(MakeReply(ServerUtc(), ServerUtc()));
+    TEST_ASSERT_TRUE(sntp.Receive(sample));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_compute);
+    RUN_TEST(test_request_format);
+    RUN_TEST(test_symmetric_delay);
+    RUN_TEST(test_asymmetric_delay);
+    RUN_TEST(test_era_rollover);
+    RUN_TEST(test_rejects_bad_replies);
+    RUN_TEST(test_stale_reply);
+    return UNITY_END();
+}
@@ -0,0 +1,123 @@
+#include <stdlib.h>
+#include <time.h>
+#include <unity.h>
+
+#include "timezone.hpp"
+
+// 2000-01-01 to 2060-01-01 UTC
+static const int64_t FROM_UTC = 946684800LL;
+static const int64_t TO_UTC = 2840140800LL;
+static const int64_t STEP = 6 * 3600 + 7 * 60;  // lands on every hour
+
+static int32_t LibcOffset(const int64_t utc) {
+    const time_t t = utc;
+    struct tm local;
+    localtime_r(&t, &local);
+    return local.tm_gmtoff;
+}
+
+// the offsets agree with the C library's on a grid over 60 years and on
+// both sides of every transition in them
+static void CheckAgainstLibc(const char* posix) {
+    TimeZone tz;
+    TEST_ASSERT_TRUE_MESSAGE(tz.Compile(posix), posix);
+    setenv("TZ", posix, 1);
+    tzset();
+
+    for (int64_t utc = FROM_UTC; utc < TO_UTC; utc += STEP) {
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(LibcOffset(utc), tz.GetOffset(utc),
+                                        posix);
+    }
+
+    int transitions = 0;
+    for (int64_t utc = tz.GetNextTransition(FROM_UTC); utc && utc < TO_UTC;
+         utc = tz.GetNextTransition(utc)) {
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(LibcOffset(utc - 1),
+                                        tz.GetOffset(utc - 1), posix);
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(LibcOffset(utc), tz.GetOffset(utc),
+                                        posix);
+        TEST_ASSERT_TRUE_MESSAGE(tz.GetOffset(utc - 1) != tz.GetOffset(utc),
+                                 posix);
+        transitions++;
+    }
+    // two a year, one of them may be right at FROM_UTC
+    if (tz.HasDST()) {
+        TEST_ASSERT_TRUE_MESSAGE(transitions == 119 || transitions == 120,
+                                 posix);
+    } else {
+        TEST_ASSERT_EQUAL_INT_MESSAGE(0, transitions, posix);
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_presets_match_libc() {
+    for (const TimeZonePreset& preset : TIME_ZONE_PRESETS) {
+        CheckAgainstLibc(preset.posix);
+    }
+}
+
+// rule formats and corner cases that none of the presets use. glibc takes
+// the rules of the UTC year, so none of these are within hours of New Year
+void test_other_rules_match_libc() {
+    const char* zones[] = {
+        "<+0330>-3:30",
+        "IST-1GMT0,M10.5.0,M3.5.0/1",     // negative DST, Ireland
+        "XXX3YYY,J60/25,J300/-1",         // Jn, times past 24 and negative
+        "AAA-2BBB-3,0/2,364/23",          // n, counts Feb 29
+        "<-03>3<-02>,M3.5.0/-2,M10.5.0/-1",  // Greenland
+        "EGT1EGST,M3.5.0/0,M10.5.0/1",
+        "LHST-10:30LHDT-11,M10.1.0,M4.1.0",  // 30 minute DST, Lord Howe
+    };
+    for (const char* posix : zones) {
+        CheckAgainstLibc(posix);
+    }
+}
+
+void test_rejects_bad_strings() {
+    const char* bad[] = {
+        "",       "U0",           "UTC",         "<+05",
+        "PST8PDT,M13.1.0,M11.1.0", "PST8PDT,M3.2.0", "PST8PDT,M3.2.0,",
+    };
+    for (const char* posix : bad) {
+        TimeZone tz;
+        TEST_ASSERT_FALSE_MESSAGE(tz.Compile(posix), posix);
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(0, tz.GetOffset(FROM_UTC), posix);
+    }
+}
+
+// the old UTC setting was entered as the summer offset
+void test_legacy_utc_setting() {
+    struct Case {
+        int hours;
+        const char* name;
+    };
+    const Case cases[] = {
+        {-10, "HST"}, {-9, "AK"},  {-7, "PST"}, {-6, "MST"},  {-5, "CST"},
+        {-4, "EST"},  {-3, "AST"}, {0, "UTC"},  {1, "GMT"},   {2, "CET"},
+        {3, "EET"},   {4, "GST"},  {8, "CHN"},  {9, "JST"},   {10, "SYD"},
+        {11, "SYD"},  {12, "NZ"},  {-12, "-12"}, {-2, "-2"},  {5, "+5"},
+        {6, "+6"},
+    };
+    for (const Case& c : cases) {
+        const TimeZonePreset* preset = TimeZone::FindLegacyPreset(c.hours);
+        TEST_ASSERT_TRUE(preset);
+        TEST_ASSERT_EQUAL_STRING(c.name, preset->name);
+    }
+
+    // every value the old setting could hold has a zone
+    for (int hours = -12; hours <= 12; ++hours) {
+        TEST_ASSERT_TRUE(TimeZone::FindLegacyPreset(hours));
+    }
+    TEST_ASSERT_FALSE(TimeZone::FindLegacyPreset(15));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_presets_match_libc);
+    RUN_TEST(test_other_rules_match_libc);
+    RUN_TEST(test_rejects_bad_strings);
+    RUN_TEST(test_legacy_utc_setting);
+    return UNITY_END();
+}
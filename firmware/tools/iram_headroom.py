@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""Shows how much of the ESP8266's IRAM a build uses, and by what.
+
+    tools/iram_headroom.py .pio/build/foxie-cardclock-hot/firmware.elf \\
+        --baseline .pio/build/foxie-cardclock/firmware.elf
+
+With --baseline, also lists the functions that are only in IRAM in the
+first build, i.e. what HOT_FUNC moved there.
+"""
+
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+
+TOOLCHAIN = os.path.expanduser("~/.platformio/packages/toolchain-xtensa/bin/")
+IRAM_START = 0x40100000
+# PIO_FRAMEWORK_ARDUINO_MMU_CACHE16_IRAM48_SECHEAP_SHARED in platformio.ini
+# gives IRAM 48KB, the rest of the 64KB is instruction cache
+IRAM_SIZE = 48 * 1024
+
+
+def find_tool(name, path):
+    if path:
+        return path
+    tool = "xtensa-lx106-elf-" + name
+    if shutil.which(tool):
+        return tool
+    if os.path.exists(TOOLCHAIN + tool):
+        return TOOLCHAIN + tool
+    sys.exit("can't find %s, give its path with --%s" % (tool, name))
+
+
+def in_iram(address, iram_size):
+    return IRAM_START <= address < IRAM_START + iram_size
+
+
+def read_iram_used(size, elf, iram_size):
+    """Bytes of the ELF's sections that are loaded into IRAM."""
+    output = subprocess.run([size, "-A", elf], check=True,
+                            capture_output=True, text=True).stdout
+    used = 0
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) == 3 and fields[1].isdigit() and fields[2].isdigit():
+            if int(fields[1]) and in_iram(int(fields[2]), iram_size):
+                used += int(fields[1])
+    return used
+
+
+def read_iram_functions(nm, elf, iram_size):
+    """{name: size} of the functions in IRAM."""
+    output = subprocess.run([nm, "-S", "-C", "--defined-only", elf],
+                            check=True, capture_output=True,
+                            text=True).stdout
+    functions = {}
+    for line in output.splitlines():
+        fields = line.split(None, 3)
+        if (len(fields) == 4 and fields[2] in "tTwW" and
+                in_iram(int(fields[0], 16), iram_size)):
+            functions[fields[3]] = int(fields[1], 16)
+    return functions
+
+
+def report(name, used, iram_size):
+    print("%s: IRAM %d of %d bytes used, %d free (%.1f%%)" %
+          (name, used, iram_size, iram_size - used,
+           100.0 * (iram_size - used) / iram_size))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="firmware.elf to look at")
+    parser.add_argument("--baseline", help="firmware.elf to compare with")
+    parser.add_argument("--iram-size", type=lambda x: int(x, 0),
+                        default=IRAM_SIZE,
+                        help="bytes of IRAM (default %d)" % IRAM_SIZE)
+    parser.add_argument("--size", help="path to xtensa-lx106-elf-size")
+    parser.add_argument("--nm", help="path to xtensa-lx106-elf-nm")
+    args = parser.parse_args()
+
+    size = find_tool("size", args.size)
+    used = read_iram_used(size, args.elf, args.iram_size)
+    report(args.elf, used, args.iram_size)
+    if not args.baseline:
+        return
+
+    baseline_used = read_iram_used(size, args.baseline, args.iram_size)
+    report(args.baseline, baseline_used, args.iram_size)
+    print("difference: %+d bytes" % (used - baseline_used))
+
+    nm = find_tool("nm", args.nm)
+    functions = read_iram_functions(nm, args.elf, args.iram_size)
+    baseline = read_iram_functions(nm, args.baseline, args.iram_size)
+    moved = sorted(((size, name) for name, size in functions.items()
+                    if name not in baseline), reverse=True)
+    if moved:
+        print("only in IRAM in %s:" % args.elf)
+        for function_size, name in moved:
+            print("%7d  %s" % (function_size, name))
+
+
+if __name__ == "__main__":
+    main()
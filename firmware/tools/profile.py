@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""Turns SamplingProfiler's output into a flat profile of functions.
+
+Build and upload the foxie-cardclock-profile env, capture the serial port
+for a while under the load you're interested in, then run this against the
+ELF from the same build:
+
+    pio run -e foxie-cardclock-profile -t upload
+    pio device monitor -e foxie-cardclock-profile | tee capture.log
+    tools/profile.py .pio/build/foxie-cardclock-profile/firmware.elf capture.log
+
+Only the "PC:" lines of the capture are read, so it may hold anything else.
+Samples in the ESP8266's mask ROM aren't in the ELF and are counted as ROM.
+"""
+
+import argparse
+import bisect
+import collections
+import os
+import shutil
+import subprocess
+import sys
+
+NM = "xtensa-lx106-elf-nm"
+PLATFORMIO_NM = os.path.expanduser(
+    "~/.platformio/packages/toolchain-xtensa/bin/" + NM)
+
+ROM_START, ROM_END = 0x40000000, 0x40010000
+
+
+def find_nm(nm):
+    if nm:
+        return nm
+    if shutil.which(NM):
+        return NM
+    if os.path.exists(PLATFORMIO_NM):
+        return PLATFORMIO_NM
+    sys.exit("can't find %s, give its path with --nm" % NM)
+
+
+def read_symbols(nm, elf):
+    """Returns the ELF's functions as sorted (start, end, name) tuples."""
+    output = subprocess.run([nm, "-n", "-S", "-C", "--defined-only", elf],
+                            check=True, capture_output=True,
+                            text=True).stdout
+    symbols = []
+    for line in output.splitlines():
+        fields = line.split(None, 3)
+        if len(fields) == 4 and fields[2] in "tTwW":
+            start, size = int(fields[0], 16), int(fields[1], 16)
+            symbols.append((start, start + size, fields[3]))
+        elif len(fields) == 3 and fields[1] in "tTwW":
+            # no size, assume it runs up to the next symbol
+            symbols.append((int(fields[0], 16), None, fields[2]))
+
+    # fill in the missing ends
+    for i, (start, end, name) in enumerate(symbols):
+        if end is None:
+            next_start = symbols[i + 1][0] if i + 1 < len(symbols) else start
+            symbols[i] = (start, next_start, name)
+    return symbols
+
+
+def read_samples(capture):
+    samples = []
+    for line in capture:
+        line = line.strip()
+        if line.startswith("PC:"):
+            samples.extend(int(pc, 16) for pc in line[3:].split())
+    return samples
+
+
+def symbolize(pc, symbols, starts):
+    if ROM_START <= pc < ROM_END:
+        return "[ROM]"
+    i = bisect.bisect_right(starts, pc) - 1
+    if i >= 0 and pc < symbols[i][1]:
+        return symbols[i][2]
+    return "[unknown 0x%08x]" % pc
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="firmware.elf the samples came from")
+    parser.add_argument("capture", nargs="?", default="-",
+                        help="serial output with PC: lines, - for stdin")
+    parser.add_argument("--nm", help="path to " + NM)
+    parser.add_argument("--top", type=int, default=40,
+                        help="how many functions to list (default 40)")
+    args = parser.parse_args()
+
+    symbols = read_symbols(find_nm(args.nm), args.elf)
+    starts = [start for start, _, _ in symbols]
+
+    if args.capture == "-":
+        samples = read_samples(sys.stdin)
+    else:
+        with open(args.capture, errors="replace") as capture:
+            samples = read_samples(capture)
+    if not samples:
+        sys.exit("no PC: lines in the capture")
+
+    counts = collections.Counter(
+        symbolize(pc, symbols, starts) for pc in samples)
+    print("%d samples" % len(samples))
+    print("%7s %6s  %s" % ("samples", "%", "function"))
+    for name, count in counts.most_common(args.top):
+        print("%7d %5.1f%%  %s" % (count, 100.0 * count / len(samples), name))
+
+
+if __name__ == "__main__":
+    main()